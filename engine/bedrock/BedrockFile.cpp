@@ -7,6 +7,18 @@
 #include "BedrockAssert.hpp"
 #include "BedrockLog.hpp"
 
+#if defined(__PLATFORM_WIN__)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 namespace MFA::File
 {
@@ -39,4 +51,113 @@ namespace MFA::File
         }
         return nullptr;
     }
-}
\ No newline at end of file
+
+    //-------------------------------------------------------------------------------------------------
+
+    MappedFile::MappedFile(std::string const & path)
+    {
+#if defined(__PLATFORM_WIN__)
+        _fileHandle = CreateFileA(
+            path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr
+        );
+        if (_fileHandle == INVALID_HANDLE_VALUE)
+        {
+            _fileHandle = nullptr;
+            return;
+        }
+
+        LARGE_INTEGER fileSize{};
+        if (GetFileSizeEx(_fileHandle, &fileSize) == FALSE || fileSize.QuadPart == 0)
+        {
+            return;
+        }
+
+        _mappingHandle = CreateFileMappingA(_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (_mappingHandle == nullptr)
+        {
+            return;
+        }
+
+        _ptr = static_cast<uint8_t *>(MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (_ptr != nullptr)
+        {
+            _len = static_cast<size_t>(fileSize.QuadPart);
+        }
+#else
+        _fileDescriptor = open(path.c_str(), O_RDONLY);
+        if (_fileDescriptor < 0)
+        {
+            return;
+        }
+
+        struct stat fileStat {};
+        if (fstat(_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+        {
+            return;
+        }
+
+        auto * ptr = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, _fileDescriptor, 0);
+        if (ptr != MAP_FAILED)
+        {
+            _ptr = static_cast<uint8_t *>(ptr);
+            _len = static_cast<size_t>(fileStat.st_size);
+        }
+#endif
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    MappedFile::~MappedFile()
+    {
+#if defined(__PLATFORM_WIN__)
+        if (_ptr != nullptr)
+        {
+            UnmapViewOfFile(_ptr);
+        }
+        if (_mappingHandle != nullptr)
+        {
+            CloseHandle(_mappingHandle);
+        }
+        if (_fileHandle != nullptr)
+        {
+            CloseHandle(_fileHandle);
+        }
+#else
+        if (_ptr != nullptr)
+        {
+            munmap(_ptr, _len);
+        }
+        if (_fileDescriptor >= 0)
+        {
+            close(_fileDescriptor);
+        }
+#endif
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    std::shared_ptr<MappedFile> Map(std::string const & path)
+    {
+        if (std::filesystem::exists(path) == false)
+        {
+            return nullptr;
+        }
+
+        auto mappedFile = std::make_shared<MappedFile>(path);
+        if (mappedFile->IsValid() == false)
+        {
+            MFA_LOG_WARN("Failed to map file %s", path.c_str());
+            return nullptr;
+        }
+        return mappedFile;
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+}
@@ -3,8 +3,35 @@
 #include <string>
 
 #include "BedrockMemory.hpp"
+#include "BedrockPlatforms.hpp"
 
 namespace MFA::File
 {
     std::shared_ptr<Blob> Read(std::string const & path);
-}
\ No newline at end of file
+
+    // Read-only view of a whole file. Pages are loaded by the OS on first access and the view is unmapped on destruction.
+    class MappedFile : public BaseBlob
+    {
+    public:
+
+        explicit MappedFile(std::string const & path);
+
+        ~MappedFile();
+
+        MappedFile(MappedFile const &) = delete;
+        MappedFile & operator=(MappedFile const &) = delete;
+
+    private:
+
+#if defined(__PLATFORM_WIN__)
+        void * _fileHandle = nullptr;
+        void * _mappingHandle = nullptr;
+#else
+        int _fileDescriptor = -1;
+#endif
+
+    };
+
+    // Returns nullptr if the file does not exist or cannot be mapped
+    std::shared_ptr<MappedFile> Map(std::string const & path);
+}
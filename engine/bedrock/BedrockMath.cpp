@@ -3,6 +3,7 @@
 #include "BedrockAssert.hpp"
 
 #include <Eigen/Eigenvalues>
+#include <Eigen/SVD>
 
 #define USE_SHAPELESS
 
@@ -406,6 +407,21 @@ namespace MFA::Math
 
 	//-------------------------------------------------------------------------------------------------
 
+	glm::dmat3 OptimalRotation(glm::dmat3 const & covariance)
+	{
+		Eigen::JacobiSVD<Eigen::Matrix3d> const svd(ToEigen(covariance), Eigen::ComputeFullU | Eigen::ComputeFullV);
+		Eigen::Matrix3d U = svd.matrixU();
+		Eigen::Matrix3d const V = svd.matrixV();
+		if ((U * V.transpose()).determinant() < 0.0)
+		{
+			// Flip the axis of the smallest singular value
+			U.col(2) *= -1.0;
+		}
+		return ToGlm(U * V.transpose());
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
 	void Translate(glm::mat4& transform, float distance[3])
 	{
 		transform = glm::translate(transform, glm::vec3(distance[0], distance[1], distance[2]));
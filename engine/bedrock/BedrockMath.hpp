@@ -201,6 +201,11 @@ namespace MFA::Math
         std::vector<glm::dvec3> const & toPoints
     );
 
+    // Rotation R that maximizes trace(R^T covariance) for covariance = sum(to * from^T), reflections are removed.
+    // Works for rank deficient covariances as well, for example edges of a planar vertex star.
+    [[nodiscard]]
+    glm::dmat3 OptimalRotation(glm::dmat3 const & covariance);
+
     [[nodiscard]]
     glm::vec4 WorldSpaceToProjectedSpace(glm::vec4 const& worldPosition, glm::mat4 const& viewProjection);
 
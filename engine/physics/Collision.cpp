@@ -1,13 +1,86 @@
 #include "Collision.hpp"
 
+#include "StaticTriangleGrid.hpp"
+#include "TriangleBVH.hpp"
+
 #include "BedrockAssert.hpp"
 #include "BedrockMath.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
 namespace MFA::Collision
 {
 
 	//-------------------------------------------------------------------------------------------------
 
+	namespace
+	{
+		constexpr int MortonBits = 19;
+
+		// Spreads the lower 21 bits of value so that two zero bits follow every bit
+		uint64_t SpreadBits(uint64_t value)
+		{
+			value &= 0x1fffff;
+			value = (value | value << 32) & 0x1f00000000ffff;
+			value = (value | value << 16) & 0x1f0000ff0000ff;
+			value = (value | value << 8) & 0x100f00f00f00f00f;
+			value = (value | value << 4) & 0x10c30c30c30c30c3;
+			value = (value | value << 2) & 0x1249249249249249;
+			return value;
+		}
+
+		//-------------------------------------------------------------------------------------------------
+
+		// Rays sorted by the octant of their direction, then along a Morton curve through their origins
+		std::vector<int> SortRaysForCoherence(
+			std::span<glm::dvec3 const> const origins,
+			std::span<glm::dvec3 const> const directions
+		)
+		{
+			auto const rayCount = static_cast<int>(origins.size());
+
+			glm::dvec3 min{ std::numeric_limits<double>::max() };
+			glm::dvec3 max{ std::numeric_limits<double>::lowest() };
+			for (auto const & origin : origins)
+			{
+				min = glm::min(min, origin);
+				max = glm::max(max, origin);
+			}
+			auto const extent = glm::max(max - min, glm::dvec3{ std::numeric_limits<double>::min() });
+			auto const scale = static_cast<double>((1 << MortonBits) - 1) / extent;
+
+			std::vector<uint64_t> keys(rayCount);
+			#pragma omp parallel for
+			for (int i = 0; i < rayCount; ++i)
+			{
+				auto const cell = (origins[i] - min) * scale;
+				uint64_t const octant =
+					(directions[i].x < 0.0 ? 1 : 0) |
+					(directions[i].y < 0.0 ? 2 : 0) |
+					(directions[i].z < 0.0 ? 4 : 0);
+				keys[i] =
+					octant << (3 * MortonBits) |
+					SpreadBits(static_cast<uint64_t>(cell.x)) |
+					SpreadBits(static_cast<uint64_t>(cell.y)) << 1 |
+					SpreadBits(static_cast<uint64_t>(cell.z)) << 2;
+			}
+
+			std::vector<int> order(rayCount);
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&keys](int const a, int const b)->bool
+			{
+				return keys[a] < keys[b];
+			});
+			return order;
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
 	bool HasIntersection(
 		Triangle const& triangle,
 		glm::dvec3 const& currentPos_,
@@ -106,7 +179,7 @@ namespace MFA::Collision
 	//-------------------------------------------------------------------------------------------------
 
 	bool HasContiniousCollision(
-		std::vector<Triangle>& triangles,
+		std::vector<Triangle> const & triangles,
 		glm::dvec3 const& prevPos,
 		glm::dvec3 const& nextPos,
 		int& outTriangleIdx,
@@ -151,6 +224,180 @@ namespace MFA::Collision
 
 	//-------------------------------------------------------------------------------------------------
 
+	bool HasContiniousCollision(
+		TriangleMesh const & mesh,
+		glm::dvec3 const& prevPos,
+		glm::dvec3 const& nextPos,
+		int& outTriangleIdx,
+		glm::dvec3& outTrianglePosition,
+		glm::dvec3& outTriangleNormal,
+		bool checkForBackCollision
+	)
+	{
+		double leastTime = -1.0;
+		for (int i = 0; i < static_cast<int>(mesh.triangles.size()); ++i)
+		{
+			auto const triangle = GenerateCollisionTriangle(mesh, i);
+
+			glm::dvec3 collisionPos{};
+			double time = 0.0;
+
+			if (HasIntersection(
+				triangle,
+				nextPos,
+				prevPos,
+				collisionPos,
+				time,
+				0.0,
+				checkForBackCollision
+			))
+			{
+				if (leastTime == -1.0 || time < leastTime)
+				{
+					leastTime = time;
+					outTriangleIdx = i;
+					outTriangleNormal = triangle.normal;
+					outTrianglePosition = collisionPos;
+				}
+			}
+		}
+
+		return leastTime != -1.0;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	bool HasContiniousCollision(
+		TriangleBVH const & bvh,
+		TriangleMesh const & mesh,
+		glm::dvec3 const& prevPos,
+		glm::dvec3 const& nextPos,
+		int& outTriangleIdx,
+		glm::dvec3& outTrianglePosition,
+		glm::dvec3& outTriangleNormal,
+		bool checkForBackCollision
+	)
+	{
+		return bvh.Raycast(
+			mesh,
+			prevPos,
+			nextPos,
+			outTriangleIdx,
+			outTrianglePosition,
+			outTriangleNormal,
+			checkForBackCollision
+		);
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	bool HasContiniousCollision(
+		StaticTriangleGrid const & grid,
+		TriangleMesh const & mesh,
+		glm::dvec3 const& prevPos,
+		glm::dvec3 const& nextPos,
+		int& outTriangleIdx,
+		glm::dvec3& outTrianglePosition,
+		glm::dvec3& outTriangleNormal,
+		bool checkForBackCollision
+	)
+	{
+		return grid.Raycast(
+			mesh,
+			prevPos,
+			nextPos,
+			outTriangleIdx,
+			outTrianglePosition,
+			outTriangleNormal,
+			checkForBackCollision
+		);
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void RaycastBatch(
+		TriangleBVH const & bvh,
+		TriangleMesh const & mesh,
+		std::span<glm::dvec3 const> const origins,
+		std::span<glm::dvec3 const> const directions,
+		double const maxDistance,
+		bool const checkForBackCollision,
+		std::span<RayHit> const outHits
+	)
+	{
+		MFA_ASSERT(origins.size() == directions.size());
+		MFA_ASSERT(origins.size() == outHits.size());
+
+		constexpr int PacketSize = TriangleBVH::MaxPacketSize;
+
+		auto const rayCount = static_cast<int>(origins.size());
+		auto const order = SortRaysForCoherence(origins, directions);
+		auto const packetCount = (rayCount + PacketSize - 1) / PacketSize;
+
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (int packetIdx = 0; packetIdx < packetCount; ++packetIdx)
+		{
+			auto const first = packetIdx * PacketSize;
+			auto const packetRayCount = std::min(PacketSize, rayCount - first);
+
+			std::array<glm::dvec3, PacketSize> prevPositions{};
+			std::array<glm::dvec3, PacketSize> nextPositions{};
+			std::array<RayHit, PacketSize> hits{};
+			for (int r = 0; r < packetRayCount; ++r)
+			{
+				auto const rayIdx = order[first + r];
+				prevPositions[r] = origins[rayIdx];
+				nextPositions[r] = origins[rayIdx] + directions[rayIdx] * maxDistance;
+			}
+
+			bvh.RaycastPacket(
+				mesh,
+				std::span{ prevPositions.data(), static_cast<size_t>(packetRayCount) },
+				std::span{ nextPositions.data(), static_cast<size_t>(packetRayCount) },
+				checkForBackCollision,
+				std::span{ hits.data(), static_cast<size_t>(packetRayCount) }
+			);
+
+			for (int r = 0; r < packetRayCount; ++r)
+			{
+				outHits[order[first + r]] = hits[r];
+			}
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void RaycastBatch(
+		TriangleMesh const & mesh,
+		std::span<glm::dvec3 const> const origins,
+		std::span<glm::dvec3 const> const directions,
+		double const maxDistance,
+		bool const checkForBackCollision,
+		std::span<RayHit> const outHits
+	)
+	{
+		MFA_ASSERT(origins.size() == directions.size());
+		MFA_ASSERT(origins.size() == outHits.size());
+
+		#pragma omp parallel for schedule(dynamic, 16)
+		for (int i = 0; i < static_cast<int>(origins.size()); ++i)
+		{
+			auto & hit = outHits[i];
+			hit = RayHit{};
+			hit.hasCollision = HasContiniousCollision(
+				mesh,
+				origins[i],
+				origins[i] + directions[i] * maxDistance,
+				hit.triangleIdx,
+				hit.position,
+				hit.normal,
+				checkForBackCollision
+			);
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
 	Triangle GenerateCollisionTriangle(glm::dvec3 const& p0, glm::dvec3 const& p1, glm::dvec3 const& p2)
 	{
 		Triangle triangle{};
@@ -160,6 +407,14 @@ namespace MFA::Collision
 
 	//-------------------------------------------------------------------------------------------------
 
+	Triangle GenerateCollisionTriangle(TriangleMesh const & mesh, int const triangleIdx)
+	{
+		auto const & [idx0, idx1, idx2] = mesh.triangles[triangleIdx];
+		return GenerateCollisionTriangle(mesh.positions[idx0], mesh.positions[idx1], mesh.positions[idx2]);
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
 	void UpdateCollisionTriangle(
 		glm::dvec3 const& p0, 
 		glm::dvec3 const& p1, 
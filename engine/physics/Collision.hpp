@@ -3,25 +3,37 @@
 #include <vec3.hpp>
 #include <vector>
 #include <set>
+#include <span>
+#include <tuple>
 
 namespace MFA::Collision
 {
     class StaticTriangleGrid;
+    class TriangleBVH;
 
+    // A triangle with everything that the intersection test derives from its corners
     struct Triangle
     {
-        inline static int nextId = 0;
-        explicit Triangle()
-        {
-            id = ++nextId;
-        }
-
-        int id = 0;
         glm::dvec3 center{};
         glm::dvec3 normal{};
         glm::dvec3 edgeNormals[3]{};
         glm::dvec3 edgeVertices[3]{};
-        bool selected = false;
+    };
+
+    // Shared corner positions and the corner indices of every triangle, a fraction of the size of a Triangle list.
+    // The derived data of a triangle is generated when it is tested.
+    struct TriangleMesh
+    {
+        std::vector<glm::dvec3> positions{};
+        std::vector<std::tuple<int, int, int>> triangles{};
+    };
+
+    struct RayHit
+    {
+        bool hasCollision = false;
+        int triangleIdx = -1;
+        glm::dvec3 position{};
+        glm::dvec3 normal{};
     };
 
     // This function can only handle external collision
@@ -81,7 +93,46 @@ namespace MFA::Collision
 
     [[nodiscard]]
     bool HasContiniousCollision(
-        std::vector<Triangle>& triangles,
+        std::vector<Triangle> const & triangles,
+        glm::dvec3 const& prevPos,
+        glm::dvec3 const& nextPos,
+        int& outTriangleIdx,
+        glm::dvec3& outTrianglePosition,
+        glm::dvec3& outTriangleNormal,
+        bool checkForBackCollision = false
+    );
+
+    [[nodiscard]]
+    bool HasContiniousCollision(
+        TriangleMesh const & mesh,
+        glm::dvec3 const& prevPos,
+        glm::dvec3 const& nextPos,
+        int& outTriangleIdx,
+        glm::dvec3& outTrianglePosition,
+        glm::dvec3& outTriangleNormal,
+        bool checkForBackCollision = false
+    );
+
+    // Same query, only the triangles in the boxes along the segment are tested.
+    // The hierarchy has to be built or refitted from the current state of the mesh.
+    [[nodiscard]]
+    bool HasContiniousCollision(
+        TriangleBVH const & bvh,
+        TriangleMesh const & mesh,
+        glm::dvec3 const& prevPos,
+        glm::dvec3 const& nextPos,
+        int& outTriangleIdx,
+        glm::dvec3& outTrianglePosition,
+        glm::dvec3& outTriangleNormal,
+        bool checkForBackCollision = false
+    );
+
+    // Same query, only the triangles in the grid cells along the segment are tested.
+    // The grid has to be built from the current state of the mesh.
+    [[nodiscard]]
+    bool HasContiniousCollision(
+        StaticTriangleGrid const & grid,
+        TriangleMesh const & mesh,
         glm::dvec3 const& prevPos,
         glm::dvec3 const& nextPos,
         int& outTriangleIdx,
@@ -90,6 +141,29 @@ namespace MFA::Collision
         bool checkForBackCollision = false
     );
 
+    // Closest hit of every ray, ray i is the segment from origins[i] to origins[i] + directions[i] * maxDistance.
+    // Rays are reordered by direction and origin so that neighbouring rays share packets, the packets are traced in
+    // parallel. outHits is in the order of the input.
+    void RaycastBatch(
+        TriangleBVH const & bvh,
+        TriangleMesh const & mesh,
+        std::span<glm::dvec3 const> origins,
+        std::span<glm::dvec3 const> directions,
+        double maxDistance,
+        bool checkForBackCollision,
+        std::span<RayHit> outHits
+    );
+
+    // Same query without a hierarchy, every ray scans all triangles
+    void RaycastBatch(
+        TriangleMesh const & mesh,
+        std::span<glm::dvec3 const> origins,
+        std::span<glm::dvec3 const> directions,
+        double maxDistance,
+        bool checkForBackCollision,
+        std::span<RayHit> outHits
+    );
+
     [[nodiscard]]
     Triangle GenerateCollisionTriangle(
         glm::dvec3 const& p0,
@@ -97,6 +171,9 @@ namespace MFA::Collision
         glm::dvec3 const& p2
     );
 
+    [[nodiscard]]
+    Triangle GenerateCollisionTriangle(TriangleMesh const & mesh, int triangleIdx);
+
     void UpdateCollisionTriangle(
         glm::dvec3 const& p0,
         glm::dvec3 const& p1,
@@ -113,5 +190,6 @@ namespace MFA::Collision
 namespace MFA
 {
     using CollisionTriangle = Collision::Triangle;
+    using CollisionMesh = Collision::TriangleMesh;
     using StaticCollisionGrid = Collision::StaticTriangleGrid;
 }
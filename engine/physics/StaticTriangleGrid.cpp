@@ -0,0 +1,366 @@
+#include "StaticTriangleGrid.hpp"
+
+#include "BedrockAssert.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace MFA::Collision
+{
+
+	//-------------------------------------------------------------------------------------------------
+
+	namespace
+	{
+		void GetTriangleBounds(TriangleMesh const & mesh, int const triangleIdx, glm::dvec3 & outMin, glm::dvec3 & outMax)
+		{
+			auto const & [idx0, idx1, idx2] = mesh.triangles[triangleIdx];
+			auto const & p0 = mesh.positions[idx0];
+			auto const & p1 = mesh.positions[idx1];
+			auto const & p2 = mesh.positions[idx2];
+			outMin = glm::min(glm::min(p0, p1), p2);
+			outMax = glm::max(glm::max(p0, p1), p2);
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	StaticTriangleGrid::StaticTriangleGrid() = default;
+
+	//-------------------------------------------------------------------------------------------------
+
+	void StaticTriangleGrid::Build(TriangleMesh const & mesh)
+	{
+		Build(mesh, Options{});
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void StaticTriangleGrid::Build(TriangleMesh const & mesh, Options const & options)
+	{
+		MFA_ASSERT(options.cellsPerTriangle > 0.0);
+		MFA_ASSERT(options.maxCellCount > 0);
+
+		Clear();
+		_triangleCount = static_cast<int>(mesh.triangles.size());
+		if (_triangleCount == 0)
+		{
+			return;
+		}
+
+		_min = glm::dvec3{ std::numeric_limits<double>::max() };
+		_max = glm::dvec3{ std::numeric_limits<double>::lowest() };
+		for (int triIdx = 0; triIdx < _triangleCount; ++triIdx)
+		{
+			glm::dvec3 triMin{};
+			glm::dvec3 triMax{};
+			GetTriangleBounds(mesh, triIdx, triMin, triMax);
+			_min = glm::min(_min, triMin);
+			_max = glm::max(_max, triMax);
+		}
+
+		// Flat or point like inputs still get a grid with a non zero size on every axis
+		auto maxExtent = std::max({ _max.x - _min.x, _max.y - _min.y, _max.z - _min.z });
+		if (maxExtent <= 0.0)
+		{
+			maxExtent = 1.0;
+		}
+		auto const padding = glm::dvec3{ maxExtent * 1e-6 };
+		_min -= padding;
+		_max += padding;
+		auto const extent = _max - _min;
+
+		// Cubic cells, the cell size grows until the cell count fits the limit
+		auto const targetCellCount = std::clamp(
+			static_cast<double>(_triangleCount) * options.cellsPerTriangle,
+			1.0,
+			static_cast<double>(options.maxCellCount)
+		);
+		auto cellSide = std::cbrt(extent.x * extent.y * extent.z / targetCellCount);
+		while (true)
+		{
+			_resolution = glm::max(glm::ivec3{ glm::ceil(extent / cellSide) }, glm::ivec3{ 1 });
+			auto const cellCount = static_cast<int64_t>(_resolution.x) * _resolution.y * _resolution.z;
+			if (cellCount <= options.maxCellCount)
+			{
+				break;
+			}
+			cellSide *= 1.1;
+		}
+		_cellSize = extent / glm::dvec3{ _resolution };
+
+		auto const cellCount = _resolution.x * _resolution.y * _resolution.z;
+
+		// Triangles are registered in every cell that their slightly enlarged bounds overlap, so hits on the border of
+		// a cell are found from both sides
+		auto const triPadding = glm::min(_cellSize.x, glm::min(_cellSize.y, _cellSize.z)) * 1e-6;
+		std::vector<glm::ivec3> cellMin(_triangleCount);
+		std::vector<glm::ivec3> cellMax(_triangleCount);
+		std::vector<int> cellCounts(cellCount, 0);
+
+		#pragma omp parallel for
+		for (int triIdx = 0; triIdx < _triangleCount; ++triIdx)
+		{
+			glm::dvec3 triMin{};
+			glm::dvec3 triMax{};
+			GetTriangleBounds(mesh, triIdx, triMin, triMax);
+			cellMin[triIdx] = GetCell(triMin - triPadding);
+			cellMax[triIdx] = GetCell(triMax + triPadding);
+
+			for (int z = cellMin[triIdx].z; z <= cellMax[triIdx].z; ++z)
+			{
+				for (int y = cellMin[triIdx].y; y <= cellMax[triIdx].y; ++y)
+				{
+					for (int x = cellMin[triIdx].x; x <= cellMax[triIdx].x; ++x)
+					{
+						auto const cellIdx = GetCellIndex(glm::ivec3{ x, y, z });
+						#pragma omp atomic
+						cellCounts[cellIdx] += 1;
+					}
+				}
+			}
+		}
+
+		_cellStart.resize(cellCount + 1);
+		_cellStart[0] = 0;
+		for (int cellIdx = 0; cellIdx < cellCount; ++cellIdx)
+		{
+			_cellStart[cellIdx + 1] = _cellStart[cellIdx] + cellCounts[cellIdx];
+		}
+		_cellTriangles.resize(_cellStart[cellCount]);
+
+		// Reused as the write position of every cell
+		std::copy(_cellStart.begin(), _cellStart.end() - 1, cellCounts.begin());
+
+		#pragma omp parallel for
+		for (int triIdx = 0; triIdx < _triangleCount; ++triIdx)
+		{
+			for (int z = cellMin[triIdx].z; z <= cellMax[triIdx].z; ++z)
+			{
+				for (int y = cellMin[triIdx].y; y <= cellMax[triIdx].y; ++y)
+				{
+					for (int x = cellMin[triIdx].x; x <= cellMax[triIdx].x; ++x)
+					{
+						auto const cellIdx = GetCellIndex(glm::ivec3{ x, y, z });
+						int position = 0;
+						#pragma omp atomic capture
+						position = cellCounts[cellIdx]++;
+						_cellTriangles[position] = triIdx;
+					}
+				}
+			}
+		}
+
+		// Threads fill the cells in any order
+		#pragma omp parallel for schedule(dynamic, 1024)
+		for (int cellIdx = 0; cellIdx < cellCount; ++cellIdx)
+		{
+			std::sort(
+				_cellTriangles.begin() + _cellStart[cellIdx],
+				_cellTriangles.begin() + _cellStart[cellIdx + 1]
+			);
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void StaticTriangleGrid::Clear()
+	{
+		_min = {};
+		_max = {};
+		_cellSize = {};
+		_resolution = {};
+		_cellStart.clear();
+		_cellTriangles.clear();
+		_triangleCount = 0;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	bool StaticTriangleGrid::IsEmpty() const
+	{
+		return _cellStart.empty();
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	int StaticTriangleGrid::GetTriangleCount() const
+	{
+		return _triangleCount;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	glm::ivec3 const & StaticTriangleGrid::GetResolution() const
+	{
+		return _resolution;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	bool StaticTriangleGrid::Raycast(
+		TriangleMesh const & mesh,
+		glm::dvec3 const & prevPos,
+		glm::dvec3 const & nextPos,
+		int & outTriangleIdx,
+		glm::dvec3 & outTrianglePosition,
+		glm::dvec3 & outTriangleNormal,
+		bool const checkForBackCollision
+	) const
+	{
+		MFA_ASSERT(static_cast<int>(mesh.triangles.size()) == _triangleCount);
+
+		if (_cellStart.empty() == true)
+		{
+			return false;
+		}
+
+		auto const direction = nextPos - prevPos;
+		auto const length = glm::length(direction);
+		if (length == 0.0)
+		{
+			return false;
+		}
+		auto const invDirection = 1.0 / direction;
+
+		// Part of the segment inside the grid, as parameters along the segment
+		double enterT = 0.0;
+		double exitT = 1.0;
+		{
+			auto const t0 = (_min - prevPos) * invDirection;
+			auto const t1 = (_max - prevPos) * invDirection;
+			auto const tNear = glm::min(t0, t1);
+			auto const tFar = glm::max(t0, t1);
+			enterT = std::max({ enterT, tNear.x, tNear.y, tNear.z });
+			exitT = std::min({ exitT, tFar.x, tFar.y, tFar.z });
+			if (enterT > exitT)
+			{
+				return false;
+			}
+		}
+
+		auto cell = GetCell(prevPos + direction * enterT);
+
+		// Parameter of the next cell border on every axis and the parameter distance between two borders
+		glm::ivec3 step{};
+		glm::dvec3 nextBorderT{};
+		glm::dvec3 borderDeltaT{};
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (direction[axis] > 0.0)
+			{
+				step[axis] = 1;
+				nextBorderT[axis] = (_min[axis] + (cell[axis] + 1) * _cellSize[axis] - prevPos[axis]) * invDirection[axis];
+				borderDeltaT[axis] = _cellSize[axis] * invDirection[axis];
+			}
+			else if (direction[axis] < 0.0)
+			{
+				step[axis] = -1;
+				nextBorderT[axis] = (_min[axis] + cell[axis] * _cellSize[axis] - prevPos[axis]) * invDirection[axis];
+				borderDeltaT[axis] = -_cellSize[axis] * invDirection[axis];
+			}
+			else
+			{
+				step[axis] = 0;
+				nextBorderT[axis] = std::numeric_limits<double>::infinity();
+				borderDeltaT[axis] = std::numeric_limits<double>::infinity();
+			}
+		}
+
+		// Hit times are distances from prevPos like in HasIntersection
+		int bestIdx = -1;
+		double bestTime = -1.0;
+
+		while (true)
+		{
+			auto const cellIdx = GetCellIndex(cell);
+			for (int i = _cellStart[cellIdx]; i < _cellStart[cellIdx + 1]; ++i)
+			{
+				auto const triIdx = _cellTriangles[i];
+				auto const triangle = GenerateCollisionTriangle(mesh, triIdx);
+
+				glm::dvec3 collisionPos{};
+				double time = 0.0;
+				if (HasIntersection(
+					triangle,
+					nextPos,
+					prevPos,
+					collisionPos,
+					time,
+					0.0,
+					checkForBackCollision
+				) == false)
+				{
+					continue;
+				}
+
+				// Among equally close hits the linear scan keeps the lowest index
+				if (bestIdx == -1 || time < bestTime || (time == bestTime && triIdx < bestIdx))
+				{
+					bestIdx = triIdx;
+					bestTime = time;
+					outTrianglePosition = collisionPos;
+					outTriangleNormal = triangle.normal;
+				}
+			}
+
+			// A hit inside the current cell can not be beaten by the cells behind it
+			auto const cellExitT = std::min({ nextBorderT.x, nextBorderT.y, nextBorderT.z });
+			if (bestIdx != -1 && bestTime / length <= cellExitT)
+			{
+				break;
+			}
+			if (cellExitT > exitT)
+			{
+				break;
+			}
+
+			int axis = 0;
+			if (nextBorderT.y < nextBorderT[axis])
+			{
+				axis = 1;
+			}
+			if (nextBorderT.z < nextBorderT[axis])
+			{
+				axis = 2;
+			}
+			cell[axis] += step[axis];
+			if (cell[axis] < 0 || cell[axis] >= _resolution[axis])
+			{
+				break;
+			}
+			nextBorderT[axis] += borderDeltaT[axis];
+		}
+
+		if (bestIdx == -1)
+		{
+			return false;
+		}
+
+		outTriangleIdx = bestIdx;
+		return true;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	glm::ivec3 StaticTriangleGrid::GetCell(glm::dvec3 const & position) const
+	{
+		auto const cell = glm::ivec3{ glm::floor((position - _min) / _cellSize) };
+		return glm::clamp(cell, glm::ivec3{ 0 }, _resolution - 1);
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	int StaticTriangleGrid::GetCellIndex(glm::ivec3 const & cell) const
+	{
+		return cell.x + _resolution.x * (cell.y + _resolution.y * cell.z);
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Collision.hpp"
+
+#include <vector>
+
+namespace MFA::Collision
+{
+    // Uniform grid over the triangles of a collision mesh for closest hit ray queries.
+    // Every cell lists the triangles whose bounds overlap it, rays walk the cells in order with a 3D-DDA and stop at the
+    // first cell that contains a hit. Building is a few linear passes, so it suits evenly tessellated surfaces that are
+    // rebuilt after every change. The grid only keeps triangle indices, queries take the mesh that it was built from.
+    class StaticTriangleGrid
+    {
+    public:
+
+        struct Options
+        {
+            double cellsPerTriangle = 1.0;  // Cell count relative to the triangle count
+            int maxCellCount = 1 << 24;
+        };
+
+        explicit StaticTriangleGrid();
+
+        void Build(TriangleMesh const & mesh);
+
+        void Build(TriangleMesh const & mesh, Options const & options);
+
+        void Clear();
+
+        [[nodiscard]]
+        bool IsEmpty() const;
+
+        [[nodiscard]]
+        int GetTriangleCount() const;
+
+        [[nodiscard]]
+        glm::ivec3 const & GetResolution() const;
+
+        // Same result as a linear scan with HasContiniousCollision, including the choice between equally close hits
+        [[nodiscard]]
+        bool Raycast(
+            TriangleMesh const & mesh,
+            glm::dvec3 const & prevPos,
+            glm::dvec3 const & nextPos,
+            int & outTriangleIdx,
+            glm::dvec3 & outTrianglePosition,
+            glm::dvec3 & outTriangleNormal,
+            bool checkForBackCollision
+        ) const;
+
+    private:
+
+        [[nodiscard]]
+        glm::ivec3 GetCell(glm::dvec3 const & position) const;
+
+        [[nodiscard]]
+        int GetCellIndex(glm::ivec3 const & cell) const;
+
+        glm::dvec3 _min{};
+        glm::dvec3 _max{};
+        glm::dvec3 _cellSize{};
+        glm::ivec3 _resolution{};
+        // Triangles of cell i are _cellTriangles[_cellStart[i]] up to _cellTriangles[_cellStart[i + 1]], in ascending order
+        std::vector<int> _cellStart{};
+        std::vector<int> _cellTriangles{};
+        int _triangleCount = 0;
+
+    };
+}
@@ -0,0 +1,692 @@
+#include "TriangleBVH.hpp"
+
+#include "BedrockAssert.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <numeric>
+
+namespace MFA::Collision
+{
+
+	//-------------------------------------------------------------------------------------------------
+
+	namespace
+	{
+		// Ranges smaller than this are built by the task that created them
+		constexpr int ParallelBuildThreshold = 4096;
+
+		struct Bounds
+		{
+			glm::dvec3 min{ std::numeric_limits<double>::max() };
+			glm::dvec3 max{ std::numeric_limits<double>::lowest() };
+
+			void Grow(glm::dvec3 const & point)
+			{
+				min = glm::min(min, point);
+				max = glm::max(max, point);
+			}
+
+			void Grow(Bounds const & other)
+			{
+				min = glm::min(min, other.min);
+				max = glm::max(max, other.max);
+			}
+
+			[[nodiscard]]
+			double Area() const
+			{
+				auto const extent = max - min;
+				return 2.0 * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+			}
+		};
+
+		struct Bin
+		{
+			Bounds bounds{};
+			int count = 0;
+		};
+
+		//-------------------------------------------------------------------------------------------------
+
+		// Slightly enlarged so that hits on the border of a triangle are not lost to rounding of the slab test
+		[[nodiscard]]
+		Bounds TriangleBounds(TriangleMesh const & mesh, int const triangleIdx)
+		{
+			auto const & [idx0, idx1, idx2] = mesh.triangles[triangleIdx];
+			Bounds bounds{};
+			bounds.Grow(mesh.positions[idx0]);
+			bounds.Grow(mesh.positions[idx1]);
+			bounds.Grow(mesh.positions[idx2]);
+			auto const magnitude = std::max({
+				1.0,
+				std::abs(bounds.min.x), std::abs(bounds.min.y), std::abs(bounds.min.z),
+				std::abs(bounds.max.x), std::abs(bounds.max.y), std::abs(bounds.max.z)
+			});
+			auto const padding = glm::dvec3{ magnitude * 1e-9 };
+			bounds.min -= padding;
+			bounds.max += padding;
+			return bounds;
+		}
+
+		//-------------------------------------------------------------------------------------------------
+
+		// Returns the parameter along the segment where it enters the box
+		[[nodiscard]]
+		bool IntersectBounds(
+			glm::dvec3 const & min,
+			glm::dvec3 const & max,
+			glm::dvec3 const & origin,
+			glm::dvec3 const & invDirection,
+			double const maxT,
+			double & outEntryT
+		)
+		{
+			auto const t0 = (min - origin) * invDirection;
+			auto const t1 = (max - origin) * invDirection;
+			auto const tNear = glm::min(t0, t1);
+			auto const tFar = glm::max(t0, t1);
+			auto const entry = std::max({ 0.0, tNear.x, tNear.y, tNear.z });
+			auto const exit = std::min({ maxT, tFar.x, tFar.y, tFar.z });
+			outEntryT = entry;
+			return entry <= exit;
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	struct TriangleBVH::BuildContext
+	{
+		std::vector<Bounds> bounds{};
+		std::vector<glm::dvec3> centroids{};
+		std::atomic<int> nodeCount{ 0 };
+	};
+
+	//-------------------------------------------------------------------------------------------------
+
+	TriangleBVH::TriangleBVH() = default;
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::Build(TriangleMesh const & mesh)
+	{
+		Build(mesh, Options{});
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::Build(TriangleMesh const & mesh, Options const & options)
+	{
+		MFA_ASSERT(options.maxLeafSize > 0);
+		MFA_ASSERT(options.binCount > 1 && options.binCount <= MaxBinCount);
+
+		Clear();
+		_options = options;
+		_triangleCount = static_cast<int>(mesh.triangles.size());
+		if (_triangleCount == 0)
+		{
+			return;
+		}
+
+		BuildContext context{};
+		context.bounds.resize(_triangleCount);
+		context.centroids.resize(_triangleCount);
+
+		#pragma omp parallel for
+		for (int i = 0; i < _triangleCount; ++i)
+		{
+			context.bounds[i] = TriangleBounds(mesh, i);
+			context.centroids[i] = (context.bounds[i].min + context.bounds[i].max) * 0.5;
+		}
+
+		_indices.resize(_triangleCount);
+		std::iota(_indices.begin(), _indices.end(), 0);
+
+		// A binary tree with non empty leaves never has more nodes than this
+		_nodes.resize(2 * _triangleCount - 1);
+		context.nodeCount.store(1);
+
+		#pragma omp parallel
+		{
+			#pragma omp single
+			{
+				BuildNode(context, 0, 0, _triangleCount, 0);
+			}
+		}
+
+		_nodes.resize(context.nodeCount.load());
+
+		_leafTriangles.Resize(_triangleCount);
+		#pragma omp parallel for
+		for (int i = 0; i < _triangleCount; ++i)
+		{
+			SetLeafTriangle(mesh, i);
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::BuildNode(BuildContext & context, int const nodeIdx, int const begin, int const end, int const depth)
+	{
+		// Nodes are never reallocated during the build, so the reference stays valid while other tasks add nodes
+		auto & node = _nodes[nodeIdx];
+		auto const count = end - begin;
+
+		Bounds nodeBounds{};
+		Bounds centroidBounds{};
+		for (int i = begin; i < end; ++i)
+		{
+			auto const triIdx = _indices[i];
+			nodeBounds.Grow(context.bounds[triIdx]);
+			centroidBounds.Grow(context.centroids[triIdx]);
+		}
+		node.min = nodeBounds.min;
+		node.max = nodeBounds.max;
+
+		if (count == 1 || depth >= MaxDepth)
+		{
+			MakeLeaf(node, begin, end);
+			return;
+		}
+
+		auto const binCount = _options.binCount;
+
+		int bestAxis = -1;
+		int bestBin = -1;
+		double bestCost = std::numeric_limits<double>::max();
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			auto const extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			if (extent <= 0.0)
+			{
+				continue;
+			}
+			auto const scale = binCount / extent;
+
+			std::array<Bin, MaxBinCount> bins{};
+			for (int i = begin; i < end; ++i)
+			{
+				auto const triIdx = _indices[i];
+				auto const bin = std::min(
+					binCount - 1,
+					static_cast<int>((context.centroids[triIdx][axis] - centroidBounds.min[axis]) * scale)
+				);
+				bins[bin].count += 1;
+				bins[bin].bounds.Grow(context.bounds[triIdx]);
+			}
+
+			// Area times count of everything right of each split plane
+			std::array<double, MaxBinCount> rightCost{};
+			Bounds rightBounds{};
+			int rightCount = 0;
+			for (int bin = binCount - 1; bin > 0; --bin)
+			{
+				rightBounds.Grow(bins[bin].bounds);
+				rightCount += bins[bin].count;
+				rightCost[bin - 1] = rightCount > 0 ? rightBounds.Area() * rightCount : 0.0;
+			}
+
+			Bounds leftBounds{};
+			int leftCount = 0;
+			for (int bin = 0; bin < binCount - 1; ++bin)
+			{
+				leftBounds.Grow(bins[bin].bounds);
+				leftCount += bins[bin].count;
+				if (leftCount == 0 || leftCount == count)
+				{
+					continue;
+				}
+				auto const cost = leftBounds.Area() * leftCount + rightCost[bin];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		int mid = begin;
+		if (bestAxis >= 0)
+		{
+			auto const nodeArea = nodeBounds.Area();
+			auto const splitCost = _options.traversalCost + (nodeArea > 0.0 ? bestCost / nodeArea : 0.0);
+			if (count <= _options.maxLeafSize && splitCost >= static_cast<double>(count))
+			{
+				MakeLeaf(node, begin, end);
+				return;
+			}
+
+			auto const axisMin = centroidBounds.min[bestAxis];
+			auto const scale = binCount / (centroidBounds.max[bestAxis] - axisMin);
+			mid = static_cast<int>(std::partition(
+				_indices.begin() + begin,
+				_indices.begin() + end,
+				[&](int const triIdx)->bool
+				{
+					auto const bin = std::min(
+						binCount - 1,
+						static_cast<int>((context.centroids[triIdx][bestAxis] - axisMin) * scale)
+					);
+					return bin <= bestBin;
+				}
+			) - _indices.begin());
+		}
+		else if (count <= _options.maxLeafSize)
+		{
+			MakeLeaf(node, begin, end);
+			return;
+		}
+
+		// All centroids are at the same place, any split is as good as another
+		if (mid == begin || mid == end)
+		{
+			mid = begin + count / 2;
+		}
+
+		auto const leftIdx = context.nodeCount.fetch_add(2);
+		node.first = leftIdx;
+		node.count = 0;
+
+		if (count >= ParallelBuildThreshold)
+		{
+			#pragma omp task default(shared) firstprivate(leftIdx, begin, mid, depth)
+			BuildNode(context, leftIdx, begin, mid, depth + 1);
+
+			BuildNode(context, leftIdx + 1, mid, end, depth + 1);
+
+			#pragma omp taskwait
+		}
+		else
+		{
+			BuildNode(context, leftIdx, begin, mid, depth + 1);
+			BuildNode(context, leftIdx + 1, mid, end, depth + 1);
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::MakeLeaf(Node & node, int const begin, int const end)
+	{
+		node.first = begin;
+		node.count = end - begin;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::Refit(TriangleMesh const & mesh)
+	{
+		MFA_ASSERT(static_cast<int>(mesh.triangles.size()) == _triangleCount);
+
+		#pragma omp parallel for
+		for (int nodeIdx = 0; nodeIdx < static_cast<int>(_nodes.size()); ++nodeIdx)
+		{
+			auto & node = _nodes[nodeIdx];
+			if (node.count == 0)
+			{
+				continue;
+			}
+			Bounds bounds{};
+			for (int i = node.first; i < node.first + node.count; ++i)
+			{
+				bounds.Grow(TriangleBounds(mesh, _indices[i]));
+				SetLeafTriangle(mesh, i);
+			}
+			node.min = bounds.min;
+			node.max = bounds.max;
+		}
+
+		// Children are always created after their parent, so going backwards visits them first
+		for (int nodeIdx = static_cast<int>(_nodes.size()) - 1; nodeIdx >= 0; --nodeIdx)
+		{
+			auto & node = _nodes[nodeIdx];
+			if (node.count > 0)
+			{
+				continue;
+			}
+			auto const & left = _nodes[node.first];
+			auto const & right = _nodes[node.first + 1];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::SetLeafTriangle(TriangleMesh const & mesh, int const entryIdx)
+	{
+		auto const & [idx0, idx1, idx2] = mesh.triangles[_indices[entryIdx]];
+		_leafTriangles.Set(entryIdx, mesh.positions[idx0], mesh.positions[idx1], mesh.positions[idx2]);
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::Clear()
+	{
+		_nodes.clear();
+		_indices.clear();
+		_leafTriangles.Resize(0);
+		_triangleCount = 0;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	bool TriangleBVH::IsEmpty() const
+	{
+		return _nodes.empty();
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	int TriangleBVH::GetTriangleCount() const
+	{
+		return _triangleCount;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	bool TriangleBVH::Raycast(
+		TriangleMesh const & mesh,
+		glm::dvec3 const & prevPos,
+		glm::dvec3 const & nextPos,
+		int & outTriangleIdx,
+		glm::dvec3 & outTrianglePosition,
+		glm::dvec3 & outTriangleNormal,
+		bool const checkForBackCollision
+	) const
+	{
+		MFA_ASSERT(static_cast<int>(mesh.triangles.size()) == _triangleCount);
+
+		if (_nodes.empty() == true)
+		{
+			return false;
+		}
+
+		RayState ray{};
+		if (InitRayState(prevPos, nextPos, ray) == false)
+		{
+			return false;
+		}
+
+		double entryT = 0.0;
+		if (IntersectBounds(_nodes[0].min, _nodes[0].max, prevPos, ray.invDirection, ray.maxT, entryT) == false)
+		{
+			return false;
+		}
+
+		std::array<int, MaxDepth + 2> stack{};
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			auto const & node = _nodes[stack[--stackSize]];
+
+			if (node.count > 0)
+			{
+				TestLeaf(node, mesh, checkForBackCollision, ray);
+				continue;
+			}
+
+			auto const leftIdx = node.first;
+			auto const rightIdx = node.first + 1;
+
+			double leftT = 0.0;
+			double rightT = 0.0;
+			auto const hitsLeft = IntersectBounds(
+				_nodes[leftIdx].min, _nodes[leftIdx].max, prevPos, ray.invDirection, ray.maxT, leftT
+			);
+			auto const hitsRight = IntersectBounds(
+				_nodes[rightIdx].min, _nodes[rightIdx].max, prevPos, ray.invDirection, ray.maxT, rightT
+			);
+
+			// The closer child is pushed last so that it is visited first
+			if (hitsLeft == true && hitsRight == true)
+			{
+				if (leftT <= rightT)
+				{
+					stack[stackSize++] = rightIdx;
+					stack[stackSize++] = leftIdx;
+				}
+				else
+				{
+					stack[stackSize++] = leftIdx;
+					stack[stackSize++] = rightIdx;
+				}
+			}
+			else if (hitsLeft == true)
+			{
+				stack[stackSize++] = leftIdx;
+			}
+			else if (hitsRight == true)
+			{
+				stack[stackSize++] = rightIdx;
+			}
+		}
+
+		if (ray.hit.hasCollision == false)
+		{
+			return false;
+		}
+
+		outTriangleIdx = ray.hit.triangleIdx;
+		outTrianglePosition = ray.hit.position;
+		outTriangleNormal = ray.hit.normal;
+		return true;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::RaycastPacket(
+		TriangleMesh const & mesh,
+		std::span<glm::dvec3 const> const prevPositions,
+		std::span<glm::dvec3 const> const nextPositions,
+		bool const checkForBackCollision,
+		std::span<RayHit> const outHits
+	) const
+	{
+		MFA_ASSERT(static_cast<int>(mesh.triangles.size()) == _triangleCount);
+		MFA_ASSERT(prevPositions.size() == nextPositions.size() && prevPositions.size() == outHits.size());
+		MFA_ASSERT(static_cast<int>(prevPositions.size()) <= MaxPacketSize);
+
+		auto const rayCount = static_cast<int>(prevPositions.size());
+
+		std::array<RayState, MaxPacketSize> rays{};
+		uint32_t rootMask = 0;
+		for (int r = 0; r < rayCount; ++r)
+		{
+			if (_nodes.empty() == false && InitRayState(prevPositions[r], nextPositions[r], rays[r]) == true)
+			{
+				rootMask |= 1u << r;
+			}
+		}
+
+		// Every entry keeps the rays that reach the box of its node
+		struct StackEntry
+		{
+			int nodeIdx = 0;
+			uint32_t rayMask = 0;
+		};
+
+		// Finds the rays of the mask that reach the box and the closest entry among them
+		auto const intersectNode = [&](Node const & node, uint32_t mask, double & outEntryT)->uint32_t
+		{
+			uint32_t hitMask = 0;
+			outEntryT = std::numeric_limits<double>::max();
+			while (mask != 0)
+			{
+				auto const r = std::countr_zero(mask);
+				mask &= mask - 1;
+				auto const & ray = rays[r];
+				double entryT = 0.0;
+				if (IntersectBounds(node.min, node.max, ray.prevPos, ray.invDirection, ray.maxT, entryT) == true)
+				{
+					hitMask |= 1u << r;
+					outEntryT = std::min(outEntryT, entryT);
+				}
+			}
+			return hitMask;
+		};
+
+		std::array<StackEntry, MaxDepth + 2> stack{};
+		int stackSize = 0;
+
+		double rootT = 0.0;
+		if (rootMask != 0)
+		{
+			rootMask = intersectNode(_nodes[0], rootMask, rootT);
+		}
+		if (rootMask != 0)
+		{
+			stack[stackSize++] = StackEntry{ .nodeIdx = 0, .rayMask = rootMask };
+		}
+
+		while (stackSize > 0)
+		{
+			auto const entry = stack[--stackSize];
+			auto const & node = _nodes[entry.nodeIdx];
+
+			if (node.count > 0)
+			{
+				// Rays may have found a closer hit since the node was pushed
+				double entryT = 0.0;
+				auto mask = intersectNode(node, entry.rayMask, entryT);
+				while (mask != 0)
+				{
+					auto const r = std::countr_zero(mask);
+					mask &= mask - 1;
+					TestLeaf(node, mesh, checkForBackCollision, rays[r]);
+				}
+				continue;
+			}
+
+			auto const leftIdx = node.first;
+			auto const rightIdx = node.first + 1;
+
+			double leftT = 0.0;
+			double rightT = 0.0;
+			auto const leftMask = intersectNode(_nodes[leftIdx], entry.rayMask, leftT);
+			auto const rightMask = intersectNode(_nodes[rightIdx], entry.rayMask, rightT);
+
+			StackEntry const left{ .nodeIdx = leftIdx, .rayMask = leftMask };
+			StackEntry const right{ .nodeIdx = rightIdx, .rayMask = rightMask };
+
+			// The closer child is pushed last so that it is visited first
+			if (leftMask != 0 && rightMask != 0)
+			{
+				if (leftT <= rightT)
+				{
+					stack[stackSize++] = right;
+					stack[stackSize++] = left;
+				}
+				else
+				{
+					stack[stackSize++] = left;
+					stack[stackSize++] = right;
+				}
+			}
+			else if (leftMask != 0)
+			{
+				stack[stackSize++] = left;
+			}
+			else if (rightMask != 0)
+			{
+				stack[stackSize++] = right;
+			}
+		}
+
+		for (int r = 0; r < rayCount; ++r)
+		{
+			outHits[r] = rays[r].hit;
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	bool TriangleBVH::InitRayState(glm::dvec3 const & prevPos, glm::dvec3 const & nextPos, RayState & outState)
+	{
+		outState = RayState{};
+		auto const direction = nextPos - prevPos;
+		outState.length = glm::length(direction);
+		if (outState.length == 0.0)
+		{
+			return false;
+		}
+		outState.prevPos = prevPos;
+		outState.nextPos = nextPos;
+		outState.invDirection = 1.0 / direction;
+		outState.maxT = 1.0;
+		outState.segment = TriangleSoA::MakeSegment(prevPos, nextPos);
+		return true;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleBVH::TestLeaf(
+		Node const & node,
+		TriangleMesh const & mesh,
+		bool const checkForBackCollision,
+		RayState & inOutState
+	) const
+	{
+		for (int chunk = node.first; chunk < node.first + node.count; chunk += TriangleSoA::MaxLanes)
+		{
+			auto candidates = _leafTriangles.FindCandidates(
+				chunk,
+				std::min(TriangleSoA::MaxLanes, node.first + node.count - chunk),
+				inOutState.segment,
+				static_cast<float>(inOutState.maxT),
+				checkForBackCollision
+			);
+
+			while (candidates != 0)
+			{
+				auto const triIdx = _indices[chunk + std::countr_zero(candidates)];
+				candidates &= candidates - 1;
+
+				auto const triangle = GenerateCollisionTriangle(mesh, triIdx);
+
+				glm::dvec3 collisionPos{};
+				double time = 0.0;
+				if (HasIntersection(
+					triangle,
+					inOutState.nextPos,
+					inOutState.prevPos,
+					collisionPos,
+					time,
+					0.0,
+					checkForBackCollision
+				) == false)
+				{
+					continue;
+				}
+
+				// Among equally close hits the linear scan keeps the lowest index
+				auto & hit = inOutState.hit;
+				if (
+					hit.hasCollision == false ||
+					time < inOutState.hitTime ||
+					(time == inOutState.hitTime && triIdx < hit.triangleIdx)
+				)
+				{
+					hit.hasCollision = true;
+					hit.triangleIdx = triIdx;
+					hit.position = collisionPos;
+					hit.normal = triangle.normal;
+					inOutState.hitTime = time;
+					inOutState.maxT = std::min(1.0, time / inOutState.length);
+				}
+			}
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Collision.hpp"
+#include "TriangleSoA.hpp"
+
+#include <span>
+#include <vector>
+
+namespace MFA::Collision
+{
+    // Bounding volume hierarchy over the triangles of a collision mesh for closest hit ray queries.
+    // Splits are chosen by the surface area heuristic over binned centroids and large subtrees are built in parallel.
+    // Leaf triangles are also kept in float SIMD layout, they are filtered there before the exact test.
+    // Queries take the same mesh that the tree was built from.
+    class TriangleBVH
+    {
+    public:
+
+        struct Options
+        {
+            int maxLeafSize = 8;            // Larger ranges are always split
+            int binCount = 16;              // Up to MaxBinCount
+            double traversalCost = 1.0;     // Relative to a single triangle test
+        };
+
+        static constexpr int MaxBinCount = 32;
+        static constexpr int MaxDepth = 60;
+        static constexpr int MaxPacketSize = 32;
+
+        explicit TriangleBVH();
+
+        void Build(TriangleMesh const & mesh);
+
+        void Build(TriangleMesh const & mesh, Options const & options);
+
+        // Updates the bounds after the positions of the mesh changed, the structure of the tree is kept.
+        // Cheaper than a build but the tree gets looser the more the triangles move.
+        void Refit(TriangleMesh const & mesh);
+
+        void Clear();
+
+        [[nodiscard]]
+        bool IsEmpty() const;
+
+        [[nodiscard]]
+        int GetTriangleCount() const;
+
+        // Same result as a linear scan with HasContiniousCollision, including the choice between equally close hits
+        [[nodiscard]]
+        bool Raycast(
+            TriangleMesh const & mesh,
+            glm::dvec3 const & prevPos,
+            glm::dvec3 const & nextPos,
+            int & outTriangleIdx,
+            glm::dvec3 & outTrianglePosition,
+            glm::dvec3 & outTriangleNormal,
+            bool checkForBackCollision
+        ) const;
+
+        // Traverses the tree once for a packet of up to MaxPacketSize rays, every hit is the one Raycast returns.
+        // Pays off when the rays are coherent, like neighbouring samples of a stroke.
+        void RaycastPacket(
+            TriangleMesh const & mesh,
+            std::span<glm::dvec3 const> prevPositions,
+            std::span<glm::dvec3 const> nextPositions,
+            bool checkForBackCollision,
+            std::span<RayHit> outHits
+        ) const;
+
+    private:
+
+        struct Node
+        {
+            glm::dvec3 min{};
+            glm::dvec3 max{};
+            int first = 0;                  // Leaf: first entry of _indices, inner node: left child, the right one follows it
+            int count = 0;                  // Number of triangles of a leaf, 0 for inner nodes
+        };
+
+        struct BuildContext;
+
+        void BuildNode(BuildContext & context, int nodeIdx, int begin, int end, int depth);
+
+        void MakeLeaf(Node & node, int begin, int end);
+
+        void SetLeafTriangle(TriangleMesh const & mesh, int entryIdx);
+
+        // Closest hit so far of a single ray, times are distances from prevPos like in HasIntersection
+        struct RayState
+        {
+            glm::dvec3 prevPos{};
+            glm::dvec3 nextPos{};
+            glm::dvec3 invDirection{};
+            double length = 0.0;
+            double maxT = 1.0;                  // Parameter along the segment, shrinks to the best hit
+            TriangleSoA::Segment segment{};
+            RayHit hit{};
+            double hitTime = 0.0;
+        };
+
+        [[nodiscard]]
+        static bool InitRayState(glm::dvec3 const & prevPos, glm::dvec3 const & nextPos, RayState & outState);
+
+        // Triangles that pass the float filter are tested exactly
+        void TestLeaf(
+            Node const & node,
+            TriangleMesh const & mesh,
+            bool checkForBackCollision,
+            RayState & inOutState
+        ) const;
+
+        Options _options{};
+        std::vector<Node> _nodes{};
+        std::vector<int> _indices{};
+        TriangleSoA _leafTriangles{};       // Entry i is triangle _indices[i]
+        int _triangleCount = 0;
+
+    };
+}
+
+namespace MFA
+{
+    using CollisionBVH = Collision::TriangleBVH;
+}
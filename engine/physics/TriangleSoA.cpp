@@ -0,0 +1,302 @@
+#include "TriangleSoA.hpp"
+
+#include "BedrockAssert.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MFA_COLLISION_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MFA_COLLISION_SSE
+#endif
+
+namespace MFA::Collision
+{
+
+	//-------------------------------------------------------------------------------------------------
+
+	namespace
+	{
+		// Margins of the float test, relative to the determinant. They only decide how many candidates reach the
+		// exact test, so they are generous.
+		constexpr float BarycentricEpsilon = 1e-4f;
+		constexpr float ParameterEpsilon = 1e-4f;
+		// Segments this close to parallel to the triangle plane are always candidates
+		constexpr float ParallelEpsilon = 1e-6f;
+
+		//-------------------------------------------------------------------------------------------------
+
+		struct Lanes
+		{
+			float const * v0[3];
+			float const * e1[3];
+			float const * e2[3];
+		};
+
+		//-------------------------------------------------------------------------------------------------
+
+#if defined(MFA_COLLISION_AVX) || defined(MFA_COLLISION_SSE)
+
+#if defined(MFA_COLLISION_AVX)
+		struct SimdOps
+		{
+			using Type = __m256;
+			static constexpr int Width = 8;
+			static Type Load(float const * values) { return _mm256_loadu_ps(values); }
+			static Type Set(float const value) { return _mm256_set1_ps(value); }
+			static Type Add(Type const a, Type const b) { return _mm256_add_ps(a, b); }
+			static Type Sub(Type const a, Type const b) { return _mm256_sub_ps(a, b); }
+			static Type Mul(Type const a, Type const b) { return _mm256_mul_ps(a, b); }
+			static Type And(Type const a, Type const b) { return _mm256_and_ps(a, b); }
+			static Type AndNot(Type const a, Type const b) { return _mm256_andnot_ps(a, b); }
+			static Type Or(Type const a, Type const b) { return _mm256_or_ps(a, b); }
+			static Type Xor(Type const a, Type const b) { return _mm256_xor_ps(a, b); }
+			static Type GreaterEqual(Type const a, Type const b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+			static Type LessEqual(Type const a, Type const b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+			static uint32_t MoveMask(Type const a) { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+		};
+#else
+		struct SimdOps
+		{
+			using Type = __m128;
+			static constexpr int Width = 4;
+			static Type Load(float const * values) { return _mm_loadu_ps(values); }
+			static Type Set(float const value) { return _mm_set1_ps(value); }
+			static Type Add(Type const a, Type const b) { return _mm_add_ps(a, b); }
+			static Type Sub(Type const a, Type const b) { return _mm_sub_ps(a, b); }
+			static Type Mul(Type const a, Type const b) { return _mm_mul_ps(a, b); }
+			static Type And(Type const a, Type const b) { return _mm_and_ps(a, b); }
+			static Type AndNot(Type const a, Type const b) { return _mm_andnot_ps(a, b); }
+			static Type Or(Type const a, Type const b) { return _mm_or_ps(a, b); }
+			static Type Xor(Type const a, Type const b) { return _mm_xor_ps(a, b); }
+			static Type GreaterEqual(Type const a, Type const b) { return _mm_cmpge_ps(a, b); }
+			static Type LessEqual(Type const a, Type const b) { return _mm_cmple_ps(a, b); }
+			static uint32_t MoveMask(Type const a) { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+		};
+#endif
+
+		// Moller-Trumbore with the float margins above for Width triangles starting at offset
+		uint32_t FindCandidatesSimd(
+			Lanes const & lanes,
+			int const offset,
+			TriangleSoA::Segment const & segment,
+			float const maxT,
+			bool const checkForBackCollision
+		)
+		{
+			using Ops = SimdOps;
+			using V = Ops::Type;
+
+			auto const dot = [](V const ax, V const ay, V const az, V const bx, V const by, V const bz)->V
+			{
+				return Ops::Add(Ops::Add(Ops::Mul(ax, bx), Ops::Mul(ay, by)), Ops::Mul(az, bz));
+			};
+
+			V const v0x = Ops::Load(lanes.v0[0] + offset);
+			V const v0y = Ops::Load(lanes.v0[1] + offset);
+			V const v0z = Ops::Load(lanes.v0[2] + offset);
+			V const e1x = Ops::Load(lanes.e1[0] + offset);
+			V const e1y = Ops::Load(lanes.e1[1] + offset);
+			V const e1z = Ops::Load(lanes.e1[2] + offset);
+			V const e2x = Ops::Load(lanes.e2[0] + offset);
+			V const e2y = Ops::Load(lanes.e2[1] + offset);
+			V const e2z = Ops::Load(lanes.e2[2] + offset);
+
+			V const dx = Ops::Set(segment.direction.x);
+			V const dy = Ops::Set(segment.direction.y);
+			V const dz = Ops::Set(segment.direction.z);
+
+			V const px = Ops::Sub(Ops::Mul(dy, e2z), Ops::Mul(dz, e2y));
+			V const py = Ops::Sub(Ops::Mul(dz, e2x), Ops::Mul(dx, e2z));
+			V const pz = Ops::Sub(Ops::Mul(dx, e2y), Ops::Mul(dy, e2x));
+			V const det = dot(e1x, e1y, e1z, px, py, pz);
+
+			V const signMask = Ops::Set(-0.0f);
+			V const absDet = Ops::AndNot(signMask, det);
+			V const sign = Ops::And(signMask, det);
+
+			V const parallelEpsilon = Ops::Mul(
+				Ops::Add(dot(e1x, e1y, e1z, e1x, e1y, e1z), dot(e2x, e2y, e2z, e2x, e2y, e2z)),
+				Ops::Set(segment.length * ParallelEpsilon)
+			);
+			V const isParallel = Ops::LessEqual(absDet, parallelEpsilon);
+
+			V const tx = Ops::Sub(Ops::Set(segment.origin.x), v0x);
+			V const ty = Ops::Sub(Ops::Set(segment.origin.y), v0y);
+			V const tz = Ops::Sub(Ops::Set(segment.origin.z), v0z);
+
+			V const qx = Ops::Sub(Ops::Mul(ty, e1z), Ops::Mul(tz, e1y));
+			V const qy = Ops::Sub(Ops::Mul(tz, e1x), Ops::Mul(tx, e1z));
+			V const qz = Ops::Sub(Ops::Mul(tx, e1y), Ops::Mul(ty, e1x));
+
+			V const u = Ops::Xor(dot(tx, ty, tz, px, py, pz), sign);
+			V const v = Ops::Xor(dot(dx, dy, dz, qx, qy, qz), sign);
+			V const hitT = Ops::Xor(dot(e2x, e2y, e2z, qx, qy, qz), sign);
+
+			V const zero = Ops::Set(0.0f);
+			V const minBary = Ops::Sub(zero, Ops::Mul(absDet, Ops::Set(BarycentricEpsilon)));
+			V const maxBary = Ops::Mul(absDet, Ops::Set(1.0f + BarycentricEpsilon));
+			V const minT = Ops::Sub(zero, Ops::Mul(absDet, Ops::Set(ParameterEpsilon)));
+			V const maxHitT = Ops::Mul(absDet, Ops::Set(maxT + ParameterEpsilon));
+
+			V inside = Ops::And(Ops::GreaterEqual(u, minBary), Ops::GreaterEqual(v, minBary));
+			inside = Ops::And(inside, Ops::LessEqual(Ops::Add(u, v), maxBary));
+			inside = Ops::And(inside, Ops::GreaterEqual(hitT, minT));
+			inside = Ops::And(inside, Ops::LessEqual(hitT, maxHitT));
+			if (checkForBackCollision == false)
+			{
+				inside = Ops::And(inside, Ops::GreaterEqual(det, zero));
+			}
+
+			return Ops::MoveMask(Ops::Or(inside, isParallel));
+		}
+
+#else
+
+		uint32_t FindCandidatesScalar(
+			Lanes const & lanes,
+			int const count,
+			TriangleSoA::Segment const & segment,
+			float const maxT,
+			bool const checkForBackCollision
+		)
+		{
+			uint32_t mask = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				glm::vec3 const v0{ lanes.v0[0][i], lanes.v0[1][i], lanes.v0[2][i] };
+				glm::vec3 const e1{ lanes.e1[0][i], lanes.e1[1][i], lanes.e1[2][i] };
+				glm::vec3 const e2{ lanes.e2[0][i], lanes.e2[1][i], lanes.e2[2][i] };
+
+				auto const p = glm::cross(segment.direction, e2);
+				auto const det = glm::dot(e1, p);
+				auto const absDet = std::abs(det);
+
+				auto const parallelEpsilon = (glm::dot(e1, e1) + glm::dot(e2, e2)) * segment.length * ParallelEpsilon;
+				if (absDet <= parallelEpsilon)
+				{
+					mask |= 1u << i;
+					continue;
+				}
+				if (checkForBackCollision == false && det < 0.0f)
+				{
+					continue;
+				}
+
+				// Same orientation for both sides, so the bounds below do not need a division
+				auto const sign = det < 0.0f ? -1.0f : 1.0f;
+				auto const t = segment.origin - v0;
+				auto const q = glm::cross(t, e1);
+				auto const u = glm::dot(t, p) * sign;
+				auto const v = glm::dot(segment.direction, q) * sign;
+				auto const hitT = glm::dot(e2, q) * sign;
+
+				auto const baryEpsilon = absDet * BarycentricEpsilon;
+				if (
+					u >= -baryEpsilon &&
+					v >= -baryEpsilon &&
+					u + v <= absDet + baryEpsilon &&
+					hitT >= -absDet * ParameterEpsilon &&
+					hitT <= absDet * (maxT + ParameterEpsilon)
+				)
+				{
+					mask |= 1u << i;
+				}
+			}
+			return mask;
+		}
+
+#endif
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	TriangleSoA::TriangleSoA() = default;
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleSoA::Resize(int const count)
+	{
+		MFA_ASSERT(count >= 0);
+		_count = count;
+		// Padding lanes are zero sized triangles at the origin, their bits are masked out
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			_v0[axis].assign(count + MaxLanes, 0.0f);
+			_e1[axis].assign(count + MaxLanes, 0.0f);
+			_e2[axis].assign(count + MaxLanes, 0.0f);
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	void TriangleSoA::Set(int const index, glm::dvec3 const & p0, glm::dvec3 const & p1, glm::dvec3 const & p2)
+	{
+		MFA_ASSERT(index >= 0 && index < _count);
+		auto const e1 = p1 - p0;
+		auto const e2 = p2 - p0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			_v0[axis][index] = static_cast<float>(p0[axis]);
+			_e1[axis][index] = static_cast<float>(e1[axis]);
+			_e2[axis][index] = static_cast<float>(e2[axis]);
+		}
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	int TriangleSoA::GetCount() const
+	{
+		return _count;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	TriangleSoA::Segment TriangleSoA::MakeSegment(glm::dvec3 const & prevPos, glm::dvec3 const & nextPos)
+	{
+		auto const direction = nextPos - prevPos;
+		return Segment{
+			.origin = glm::vec3{ prevPos },
+			.direction = glm::vec3{ direction },
+			.length = static_cast<float>(glm::length(direction))
+		};
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+	uint32_t TriangleSoA::FindCandidates(
+		int const first,
+		int const count,
+		Segment const & segment,
+		float const maxT,
+		bool const checkForBackCollision
+	) const
+	{
+		MFA_ASSERT(count > 0 && count <= MaxLanes);
+		MFA_ASSERT(first >= 0 && first + count <= _count);
+
+		Lanes const lanes{
+			.v0 = { _v0[0].data() + first, _v0[1].data() + first, _v0[2].data() + first },
+			.e1 = { _e1[0].data() + first, _e1[1].data() + first, _e1[2].data() + first },
+			.e2 = { _e2[0].data() + first, _e2[1].data() + first, _e2[2].data() + first },
+		};
+
+		uint32_t mask = 0;
+#if defined(MFA_COLLISION_AVX) || defined(MFA_COLLISION_SSE)
+		for (int offset = 0; offset < count; offset += SimdOps::Width)
+		{
+			mask |= FindCandidatesSimd(lanes, offset, segment, maxT, checkForBackCollision) << offset;
+		}
+#else
+		mask = FindCandidatesScalar(lanes, count, segment, maxT, checkForBackCollision);
+#endif
+		return mask & ((1u << count) - 1u);
+	}
+
+	//-------------------------------------------------------------------------------------------------
+
+}
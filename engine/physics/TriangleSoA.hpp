@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Collision.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace MFA::Collision
+{
+    // Collision triangles as float structure of arrays for testing several triangles against a segment at once.
+    // Triangle i is made of v0, v0 + e1 and v0 + e2. The arrays are padded so that a whole SIMD register can be loaded
+    // starting at any triangle. Tests are Moller-Trumbore with AVX, SSE or a scalar loop depending on the build.
+    class TriangleSoA
+    {
+    public:
+
+        static constexpr int MaxLanes = 8;
+
+        // A segment in the float precision of the store, parameters go from 0 at the start to 1 at the end
+        struct Segment
+        {
+            glm::vec3 origin{};
+            glm::vec3 direction{};
+            float length = 0.0f;
+        };
+
+        explicit TriangleSoA();
+
+        void Resize(int count);
+
+        // Not synchronized per triangle, but different indices can be set from different threads
+        void Set(int index, glm::dvec3 const & p0, glm::dvec3 const & p1, glm::dvec3 const & p2);
+
+        [[nodiscard]]
+        int GetCount() const;
+
+        [[nodiscard]]
+        static Segment MakeSegment(glm::dvec3 const & prevPos, glm::dvec3 const & nextPos);
+
+        // Bit i is set if the segment may cross triangle first + i before maxT, count is at most MaxLanes.
+        // The test is conservative against float rounding, candidates still have to be confirmed by HasIntersection.
+        [[nodiscard]]
+        uint32_t FindCandidates(
+            int first,
+            int count,
+            Segment const & segment,
+            float maxT,
+            bool checkForBackCollision
+        ) const;
+
+    private:
+
+        int _count = 0;
+        std::vector<float> _v0[3]{};
+        std::vector<float> _e1[3]{};
+        std::vector<float> _e2[3]{};
+
+    };
+}
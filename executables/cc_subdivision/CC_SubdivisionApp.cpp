@@ -1,12 +1,10 @@
 #include "CC_SubdivisionApp.hpp"
 
 #include "geometrycentral/surface/meshio.h"
-#include "geometrycentral/surface/subdivide.h"
 #include "Curve.hpp"
 
-#include <omp.h>
-
 #include "Subdivision.hpp"
+#include "SubdivisionCache.hpp"
 
 using namespace geometrycentral::surface;
 
@@ -28,8 +26,8 @@ CC_SubdivisionApp::CC_SubdivisionApp()
 {
 	MFA_LOG_DEBUG("Loading...");
 
-	omp_set_num_threads(static_cast<int>(static_cast<float>(std::thread::hardware_concurrency()) * 0.8f));
-	MFA_LOG_INFO("Number of available workers are: %d", omp_get_max_threads());
+	// Also sets the number of OpenMP threads
+	jobSystem = JobSystem::Instantiate();
 
 	path = Path::Instantiate();
 
@@ -139,7 +137,9 @@ CC_SubdivisionApp::CC_SubdivisionApp()
 
 	surfaceMeshList.emplace_back(std::make_shared<shared::SurfaceMesh>(copyMesh, copyGeom));
 
-	subdivisionDirtyStatus.emplace_back(false);
+	subdivisionCache = std::make_unique<SubdivisionCache>(Path::Instance->Get("cache"), *copyMesh);
+
+	displacementFields.emplace_back();
 
 	meshRenderer = std::make_shared<MeshRenderer>(
 		colorPipeline,
@@ -154,7 +154,8 @@ CC_SubdivisionApp::CC_SubdivisionApp()
 		curtainHeight
 	);
 
-	meshCollisionTriangles = meshRenderer->GetCollisionTriangles(meshModelMat);
+	meshCollisionMesh = meshRenderer->GetCollisionMesh(meshModelMat);
+	meshCollisionBVH.Build(meshCollisionMesh);
 	curtainCollisionTriangles = curtainRenderer->GetCollisionTriangles();
 
 	linePipeline = std::make_shared<LinePipeline>(displayRenderPass, cameraBuffer, 10000);
@@ -165,6 +166,7 @@ CC_SubdivisionApp::CC_SubdivisionApp()
 
 CC_SubdivisionApp::~CC_SubdivisionApp()
 {
+	CancelDeformation(true);
 	lineRenderer.reset();
 	linePipeline.reset();
 	curtainRenderer.reset();
@@ -183,6 +185,7 @@ CC_SubdivisionApp::~CC_SubdivisionApp()
 	msaaResource.reset();
 	device.reset();
 	path.reset();
+	jobSystem.reset();
 }
 
 //-----------------------------------------------------
@@ -253,6 +256,8 @@ void CC_SubdivisionApp::Update()
 		PerformRaycast();
 
 	}
+
+	UpdateDeformation();
 }
 
 //-----------------------------------------------------
@@ -328,45 +333,51 @@ void CC_SubdivisionApp::OnUI()
 			subdivisionLevel = 0;
 		}
 
-		// TODO: Move to a function
-		for (int lvl = static_cast<int>(surfaceMeshList.size()) - 1; lvl < subdivisionLevel; ++lvl)
-		{
-			std::shared_ptr subdividedMesh = surfaceMeshList[lvl]->GetMesh()->copy();
-			std::shared_ptr subdividedGeometry = surfaceMeshList[lvl]->GetGeometry()->reinterpretTo(*subdividedMesh);
-
-			std::shared_ptr contribMap = shared::CatmullClarkSubdivide(*subdividedMesh, *subdividedGeometry);
+		// The running solve reads the current levels
+		CancelDeformation(true);
 
-			contributionMapList.emplace_back(contribMap);
-			surfaceMeshList.emplace_back(std::make_shared<shared::SurfaceMesh>(subdividedMesh, subdividedGeometry));
-			subdivisionDirtyStatus.emplace_back(false);
-		}
+		// Existing levels only receive what changed on the coarser levels since they were last synced
+		std::vector<int> dirtyTriangles{};
+		SyncLevels(std::min(subdivisionLevel, static_cast<int>(surfaceMeshList.size()) - 1), dirtyTriangles);
 
-		for (int lvl = 1; lvl <= subdivisionLevel; ++lvl)
+		// TODO: Move to a function
+		for (int lvl = static_cast<int>(surfaceMeshList.size()) - 1; lvl < subdivisionLevel; ++lvl)
 		{
-			if (subdivisionDirtyStatus[lvl] == true)
+			SubdivisionResult result{};
+			if (subdivisionCache->TryLoad(
+				lvl + 1,
+				*surfaceMeshList[lvl]->GetMesh(),
+				*surfaceMeshList[lvl]->GetGeometry(),
+				parallelSubdivision,
+				result
+			) == false)
+			{
+				result = shared::CatmullClarkSubdivide(
+					*surfaceMeshList[lvl]->GetMesh(),
+					*surfaceMeshList[lvl]->GetGeometry(),
+					parallelSubdivision
+				);
+				subdivisionCache->Store(lvl + 1, *result.mesh, *result.contributionMap);
+			}
+			auto & [subdividedMesh, subdividedGeometry, contribMap] = result;
+			if (lvl + 1 >= compressStencilsFromLvl)
 			{
-				std::shared_ptr subdividedMesh = surfaceMeshList[lvl - 1]->GetMesh()->copy();
-				std::shared_ptr subdividedGeometry = surfaceMeshList[lvl - 1]->GetGeometry()->reinterpretTo(*subdividedMesh);
-
-				geometrycentral::surface::catmullClarkSubdivide(*subdividedMesh, *subdividedGeometry);
-
-				auto const findDeformationsResult = deformationsPerLvl.find(lvl);
-				if (findDeformationsResult != deformationsPerLvl.end())
-				{
-					auto & positions = subdividedGeometry->vertexPositions;
-					for (auto & [idx, deformation] : findDeformationsResult->second)
-					{
-						positions[idx] += deformation;
-					}
-				}
-
-				surfaceMeshList[lvl]->UpdateGeometry(subdividedMesh, subdividedGeometry);
-				subdivisionDirtyStatus[lvl] = false;
+				contribMap->Compress();
 			}
+
+			contributionMapList.emplace_back(std::move(contribMap));
+			surfaceMeshList.emplace_back(std::make_shared<shared::SurfaceMesh>(
+				std::move(subdividedMesh),
+				std::move(subdividedGeometry)
+			));
+			// The new level is built from the current positions, so it already contains every change
+			displacementFields[lvl].ClearChanges();
+			displacementFields.emplace_back();
 		}
 
 		meshRenderer->UpdateGeometry(surfaceMeshList[subdivisionLevel]);
-		meshCollisionTriangles = meshRenderer->GetCollisionTriangles(meshModelMat);
+		meshCollisionMesh = meshRenderer->GetCollisionMesh(meshModelMat);
+		meshCollisionBVH.Build(meshCollisionMesh);
 
 		ClearCurtain();
 		ClearRaycastPoints();
@@ -385,7 +396,23 @@ void CC_SubdivisionApp::OnUI()
 	ImGui::InputInt("Laplacian distance", &laplacianDistance);
 	ImGui::InputFloat("Laplacian weight", &laplacianWeight);
 	ImGui::InputInt("Number of effected levels", &numberOfEffectLevels);
+	if (ImGui::InputInt("Preview levels", &previewLevels))
+	{
+		previewLevels = std::max(previewLevels, 0);
+	}
+	if (ImGui::InputFloat("Constraint merge distance", &constraintMergeDistance))
+	{
+		constraintMergeDistance = std::max(constraintMergeDistance, 0.0f);
+	}
 	ImGui::Checkbox("Curtain", &drawCurtain);
+	ImGui::Checkbox("Parallel subdivision", &parallelSubdivision);
+	ImGui::Checkbox("Multigrid solver", &useMultigridSolver);
+	ImGui::Checkbox("As rigid as possible", &useArap);
+	if (useArap == true && ImGui::InputInt("ARAP iterations", &arapIterations))
+	{
+		arapIterations = std::max(arapIterations, 0);
+	}
+	ImGui::InputInt("Compress stencils from level", &compressStencilsFromLvl);
 	if (drawMode == DrawMode::OnCurtain)
 	{
 		if (ImGui::Button("Clear curtain"))
@@ -395,13 +422,29 @@ void CC_SubdivisionApp::OnUI()
 		if (rayCastPoints.size() >= 2 && ImGui::Button("Deform mesh"))
 		{
 			DeformMesh();
-
-			for (int lvl = subdivisionLevel + 1; lvl < static_cast<int>(surfaceMeshList.size()); ++lvl)
-			{
-				subdivisionDirtyStatus[lvl] = true;
-			}
 		}
 	}
+	if (deformationJob != nullptr)
+	{
+		ImGui::ProgressBar(deformationJob->progress.load(std::memory_order_relaxed), ImVec2(-1.0f, 0.0f), "Deforming");
+		if (ImGui::Button("Cancel deformation"))
+		{
+			CancelDeformation(false);
+		}
+	}
+	ImGui::BeginDisabled(undoLevels.empty() == true);
+	if (ImGui::Button("Undo"))
+	{
+		UndoDeformation();
+	}
+	ImGui::EndDisabled();
+	ImGui::SameLine();
+	ImGui::BeginDisabled(redoLevels.empty() == true);
+	if (ImGui::Button("Redo"))
+	{
+		RedoDeformation();
+	}
+	ImGui::EndDisabled();
 	ImGui::InputFloat4("Light position", reinterpret_cast<float *>(& lightPosition));
 	ImGui::InputFloat4("Light color", reinterpret_cast<float*>(&lightColor));
 	ui->EndWindow();
@@ -419,6 +462,8 @@ void CC_SubdivisionApp::OnSDL_Event(SDL_Event* event)
 	if (event->type == SDL_MOUSEBUTTONDOWN && event->button.button == SDL_BUTTON_RIGHT)
 	{
 		rightMouseDown = true;
+		// A new stroke replaces the one that is being solved
+		CancelDeformation(false);
 		ClearRaycastPoints();
 	}
 	else if (event->type == SDL_MOUSEBUTTONUP && event->button.button == SDL_BUTTON_RIGHT)
@@ -460,137 +505,321 @@ void CC_SubdivisionApp::ClearCurtain()
 
 void CC_SubdivisionApp::DeformMesh()
 {
-	ProjectCurtainPoints();
+	// Only one solve can use the engine at a time
+	CancelDeformation(true);
+
+	std::vector<glm::vec3> projDirections{};
+	for (auto const rayCastTriIndex : rayCastTriIndices)
+	{
+		projDirections.emplace_back(curtainRenderer->GetTriangleProjectionDirection(rayCastTriIndex));
+	}
+
+	auto job = std::make_shared<DeformationJob>();
+	job->input = DeformationEngine::Input{
+		.contributionMaps = &contributionMapList,
+		.collisionMesh = &meshCollisionMesh,
+		.collisionBVH = &meshCollisionBVH,
+		.strokePoints = rayCastPoints,
+		.projectionDirections = std::move(projDirections),
+		.cancelRequested = &job->cancelRequested,
+		.progress = &job->progress
+	};
+	for (int lvl = 0; lvl <= subdivisionLevel; ++lvl)
+	{
+		job->input.levels.emplace_back(DeformationEngine::Level{
+			.mesh = surfaceMeshList[lvl]->GetMesh().get(),
+			.geometry = surfaceMeshList[lvl]->GetGeometry().get()
+		});
+	}
+	job->parameters = DeformationEngine::Parameters{
+		.deltaS = deltaS,
+		.laplacianDistance = laplacianDistance,
+		.laplacianWeight = laplacianWeight,
+		.numberOfEffectLevels = numberOfEffectLevels,
+		.solver = useMultigridSolver == true 
+			? DeformationEngine::SolverType::Multigrid 
+			: DeformationEngine::SolverType::Direct,
+		.constraintMergeDistance = constraintMergeDistance,
+		.model = useArap == true
+			? DeformationEngine::DeformationModel::AsRigidAsPossible
+			: DeformationEngine::DeformationModel::Laplacian,
+		.arapIterations = arapIterations,
+		.previewLevels = previewLevels
+	};
+	if (previewLevels > 0)
+	{
+		// The job owns the input, so a raw pointer avoids a reference cycle
+		DeformationJob * const jobPtr = job.get();
+		job->input.onPreview = [jobPtr](DeformationEngine::Result const & preview)->void
+		{
+			jobPtr->preview = preview;
+			jobPtr->previewReady.store(true, std::memory_order_release);
+		};
+	}
+
 	ClearCurtain();
 
-	MFA_ASSERT(sampledPoints.size() == projPoints.size());
+	job->future = JobSystem::Instance->AssignTask([this, job]()->void
+	{
+		job->deformed = deformationEngine.Deform(job->input, job->parameters, job->result);
+	});
+	deformationJob = std::move(job);
+}
 
-	std::vector<glm::vec3> movableVertices{};
-	std::vector<int> vertexGIndices{};
-	std::vector<std::tuple<int, int, float>> vToPContrib{};													// For projection
-	CalcVertexToPointContribution(movableVertices, vertexGIndices, vToPContrib);							// Global indices
-
-	std::vector<glm::vec3> allVertices(movableVertices.begin(), movableVertices.end());
-	std::vector<std::tuple<int, int, float>> vToVContrib{};													// For laplacian
-	std::unordered_map<int, glm::vec3> localIdxToLaplacian{};
-	CalcLaplacianContribution(
-		movableVertices, 
-		vertexGIndices,
-		allVertices, 
-		vToVContrib, 
-		localIdxToLaplacian
-	);
+//-----------------------------------------------------
 
-	//https://eigen.tuxfamily.org/dox-devel/group__LeastSquares.html
-	// I either have to solve it three times or combine them in one giant matrix
-	Eigen::MatrixXf B (projPoints.size(), movableVertices.size());
-	B.setZero();
-	for (auto& [vIdx, pIdx, value] : vToPContrib)
+void CC_SubdivisionApp::UpdateDeformation()
+{
+	if (deformationJob == nullptr)
 	{
-		MFA_ASSERT(B.rows() > pIdx);
-		MFA_ASSERT(B.cols() > vIdx);
-		B(pIdx, vIdx) += value;
+		return;
 	}
-	auto const BT = B.transpose();
 
-	Eigen::MatrixXf Y(allVertices.size(), movableVertices.size());
-	Y.setZero();
-	for (auto& [nIdx, myIdx, value] : vToVContrib)
+	// The preview is shown until the exact result replaces it
+	if (
+		deformationJob->previewApplied == false &&
+		deformationJob->cancelRequested.load() == false &&
+		deformationJob->previewReady.load(std::memory_order_acquire) == true
+	)
 	{
-		if (Y.rows() > myIdx && Y.cols() > nIdx)
+		for (auto const & displacement : deformationJob->preview.displacements)
 		{
-			MFA_ASSERT(Y(myIdx, nIdx) == 0.0f);
-			Y(myIdx, nIdx) = value;
+			deformationJob->previewPositions.Save(
+				displacement.level,
+				displacement.vertexIndices,
+				surfaceMeshList[displacement.level]->GetGeometry()->vertexPositions
+			);
 		}
+		ApplyDisplacements(deformationJob->preview.displacements);
+		deformationJob->previewApplied = true;
+	}
+
+	if (deformationJob->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		return;
+	}
+
+	auto const job = std::move(deformationJob);
+	job->future.get();
+	RevertPreview(*job);
+
+	if (job->cancelRequested.load() == true)
+	{
+		return;
 	}
 
-	auto const YT = Y.transpose();
+	ApplyDeformation(job->deformed, job->result);
+}
 
-	auto const A = (BT * B * (1.0f - laplacianWeight)) + (YT * Y * laplacianWeight);
+//-----------------------------------------------------
 
-	Eigen::MatrixXf bx(projPoints.size(), 1);
-	Eigen::MatrixXf by(projPoints.size(), 1);
-	Eigen::MatrixXf bz(projPoints.size(), 1);
-	for (int i = 0; i < static_cast<int>(projPoints.size()); ++i)
+void CC_SubdivisionApp::ApplyDeformation(bool const deformed, DeformationEngine::Result & result)
+{
+	sampledPoints = std::move(result.sampledPoints);
+	sampledNormals = std::move(result.sampledNormals);
+	projPoints = std::move(result.projectedPoints);
+	projNormals = std::move(result.projectedNormals);
+	projTriIndices = std::move(result.projectedTriangles);
+	MFA_ASSERT(sampledPoints.size() == projPoints.size());
+
+	if (deformed == false)
 	{
-		bx(i, 0) = sampledPoints[i].x - projPoints[i].x;
-		by(i, 0) = sampledPoints[i].y - projPoints[i].y;
-		bz(i, 0) = sampledPoints[i].z - projPoints[i].z;
+		return;
 	}
 
-	Eigen::MatrixXf yX(allVertices.size(), 1);
-	Eigen::MatrixXf yY(allVertices.size(), 1);
-	Eigen::MatrixXf yZ(allVertices.size(), 1);
-	for (int localIdx = 0; localIdx < static_cast<int>(allVertices.size()); ++localIdx)
+	ApplyDisplacements(result.displacements);
+
+	// The engine already propagated the edit up to the drawn level, finer levels are synced when they are shown
+	auto const & solvedDisplacement = result.displacements.front();
+	auto const & drawnDisplacement = result.displacements.back();
+	// A new edit ends every redo chain, not only the one of the level it was made at
+	for (int const lvl : redoLevels)
 	{
-		auto const& laplacian = localIdxToLaplacian[localIdx];
-		yX(localIdx, 0) = -laplacian.x;
-		yY(localIdx, 0) = -laplacian.y;
-		yZ(localIdx, 0) = -laplacian.z;
+		displacementFields[lvl].ClearRedo();
 	}
+	redoLevels.clear();
 
-	Eigen::BDCSVD<Eigen::MatrixXf> SVD(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
+	displacementFields[solvedDisplacement.level].Record(solvedDisplacement.vertexIndices, solvedDisplacement.deltas);
+	displacementFields[drawnDisplacement.level].MarkChanged(drawnDisplacement.vertexIndices, drawnDisplacement.deltas);
+	undoLevels.emplace_back(solvedDisplacement.level);
 
-	auto const Dx = SVD.solve((BT * bx * (1.0f - laplacianWeight)) + (YT * yX * laplacianWeight));
-	auto const Dy = SVD.solve((BT * by * (1.0f - laplacianWeight)) + (YT * yY * laplacianWeight));
-	auto const Dz = SVD.solve((BT * bz * (1.0f - laplacianWeight)) + (YT * yZ * laplacianWeight));
+	// The oldest entry of undoLevels is the oldest edit of its level
+	while (static_cast<int>(undoLevels.size()) > maxUndoCount)
+	{
+		displacementFields[undoLevels.front()].DropOldestEdit();
+		undoLevels.erase(undoLevels.begin());
+	}
+}
+
+//-----------------------------------------------------
+
+void CC_SubdivisionApp::ApplyDisplacements(std::vector<DeformationEngine::LevelDisplacement> const & displacements)
+{
+	// Every level is updated within the same frame so the displayed geometry switches at once
+	std::vector<int> dirtyTriangles{};
+	for (auto const & displacement : displacements)
+	{
+		auto & positions = surfaceMeshList[displacement.level]->GetGeometry()->vertexPositions;
+		for (int i = 0; i < static_cast<int>(displacement.vertexIndices.size()); ++i)
+		{
+			positions[displacement.vertexIndices[i]] += displacement.deltas[i];
+		}
+		surfaceMeshList[displacement.level]->UpdatePositions(displacement.vertexIndices, dirtyTriangles);
+	}
 
-	int lvl = subdivisionLevel - numberOfEffectLevels;
+	MFA_ASSERT(displacements.empty() == true || displacements.back().level == subdivisionLevel);
+	meshRenderer->UpdateGeometry(surfaceMeshList[subdivisionLevel]);
+	surfaceMeshList[subdivisionLevel]->UpdateCollisionMesh(meshModelMat, dirtyTriangles, meshCollisionMesh);
+	meshCollisionBVH.Refit(meshCollisionMesh);
+}
 
-	auto const& subdividedGeometry = surfaceMeshList[lvl]->GetGeometry();
-	auto const& subdividedMesh = surfaceMeshList[lvl]->GetMesh();
+//-----------------------------------------------------
 
-	if (deformationsPerLvl.contains(lvl) == false)
+void CC_SubdivisionApp::RevertPreview(DeformationJob & job)
+{
+	if (job.previewApplied == false)
 	{
-		deformationsPerLvl[lvl] = {};
+		return;
 	}
 
-	for (int i = 0; i < static_cast<int>(movableVertices.size()); ++i)
+	std::vector<int> dirtyTriangles{};
+	for (auto const & displacement : job.preview.displacements)
 	{
-		auto const idx = surfaceMeshList[lvl]->GetVertexIdx(movableVertices[i]);
+		job.previewPositions.Restore(
+			displacement.level,
+			surfaceMeshList[displacement.level]->GetGeometry()->vertexPositions
+		);
+		surfaceMeshList[displacement.level]->UpdatePositions(displacement.vertexIndices, dirtyTriangles);
+	}
+	job.previewPositions.Clear();
+	job.previewApplied = false;
+
+	meshRenderer->UpdateGeometry(surfaceMeshList[subdivisionLevel]);
+	surfaceMeshList[subdivisionLevel]->UpdateCollisionMesh(meshModelMat, dirtyTriangles, meshCollisionMesh);
+	meshCollisionBVH.Refit(meshCollisionMesh);
+}
 
-		subdividedGeometry->vertexPositions[idx].x += Dx(i, 0);
-		subdividedGeometry->vertexPositions[idx].y += Dy(i, 0);
-		subdividedGeometry->vertexPositions[idx].z += Dz(i, 0);
+//-----------------------------------------------------
 
-		deformationsPerLvl[lvl].emplace_back(
-			std::tuple{
-				idx,
-				Vector3 {
-					Dx(i, 0),
-					Dy(i, 0),
-					Dz(i, 0)
-				}
-			}
-		);
+void CC_SubdivisionApp::UndoDeformation()
+{
+	if (undoLevels.empty() == true)
+	{
+		return;
 	}
+	CancelDeformation(true);
+
+	auto const lvl = undoLevels.back();
+	undoLevels.pop_back();
 
-	surfaceMeshList[lvl]->UpdateGeometry(subdividedMesh, subdividedGeometry);
+	std::vector<int> vertexIndices{};
+	std::vector<geometrycentral::Vector3> deltas{};
+	bool const undone = displacementFields[lvl].Undo(vertexIndices, deltas);
+	MFA_ASSERT(undone == true);
+	MoveVertices(lvl, vertexIndices, deltas);
+	redoLevels.emplace_back(lvl);
+}
+
+//-----------------------------------------------------
 
-	for (int nextLvl = lvl + 1; nextLvl <= subdivisionLevel; ++nextLvl)
+void CC_SubdivisionApp::RedoDeformation()
+{
+	if (redoLevels.empty() == true)
 	{
-		int prevLvl = nextLvl - 1;
+		return;
+	}
+	CancelDeformation(true);
+
+	auto const lvl = redoLevels.back();
+	redoLevels.pop_back();
+
+	std::vector<int> vertexIndices{};
+	std::vector<geometrycentral::Vector3> deltas{};
+	bool const redone = displacementFields[lvl].Redo(vertexIndices, deltas);
+	MFA_ASSERT(redone == true);
+	MoveVertices(lvl, vertexIndices, deltas);
+	undoLevels.emplace_back(lvl);
+}
+
+//-----------------------------------------------------
 
-		std::shared_ptr subdividedMesh = surfaceMeshList[prevLvl]->GetMesh()->copy();
-		std::shared_ptr subdividedGeometry = surfaceMeshList[prevLvl]->GetGeometry()->reinterpretTo(*subdividedMesh);
+void CC_SubdivisionApp::MoveVertices(
+	int const lvl,
+	std::vector<int> const & vertexIndices,
+	std::vector<geometrycentral::Vector3> const & deltas
+)
+{
+	auto & positions = surfaceMeshList[lvl]->GetGeometry()->vertexPositions;
+	for (int i = 0; i < static_cast<int>(vertexIndices.size()); ++i)
+	{
+		positions[vertexIndices[i]] += deltas[i];
+	}
 
-		geometrycentral::surface::catmullClarkSubdivide(*subdividedMesh, *subdividedGeometry);
+	std::vector<int> dirtyTriangles{};
+	surfaceMeshList[lvl]->UpdatePositions(vertexIndices, dirtyTriangles);
+	displacementFields[lvl].MarkChanged(vertexIndices, deltas);
 
-		auto const findDeformationsResult = deformationsPerLvl.find(nextLvl);
-		if (findDeformationsResult != deformationsPerLvl.end())
+	if (lvl > subdivisionLevel)
+	{
+		return;
+	}
+	if (lvl < subdivisionLevel)
+	{
+		SyncLevels(subdivisionLevel, dirtyTriangles);
+	}
+
+	meshRenderer->UpdateGeometry(surfaceMeshList[subdivisionLevel]);
+	surfaceMeshList[subdivisionLevel]->UpdateCollisionMesh(meshModelMat, dirtyTriangles, meshCollisionMesh);
+	meshCollisionBVH.Refit(meshCollisionMesh);
+}
+
+//-----------------------------------------------------
+
+void CC_SubdivisionApp::SyncLevels(int const toLevel, std::vector<int> & outDirtyTriangles)
+{
+	std::vector<int> prevIndices{};
+	std::vector<geometrycentral::Vector3> prevDeltas{};
+	std::vector<int> nextIndices{};
+	std::vector<geometrycentral::Vector3> nextDeltas{};
+
+	for (int lvl = 1; lvl <= toLevel; ++lvl)
+	{
+		auto & prevField = displacementFields[lvl - 1];
+		if (prevField.IsDirty() == false)
 		{
-			auto& positions = subdividedGeometry->vertexPositions;
-			for (auto& [idx, deformation] : findDeformationsResult->second)
-			{
-				positions[idx] += deformation;
-			}
+			continue;
 		}
 
-		surfaceMeshList[nextLvl]->UpdateGeometry(subdividedMesh, subdividedGeometry);
+		// Subdivision is linear, so moving the coarse vertices moves the fine ones by the stencils of the change
+		prevField.TakeChanges(prevIndices, prevDeltas);
+		contributionMapList[lvl - 1]->PropagateDelta(prevIndices, prevDeltas, nextIndices, nextDeltas);
+
+		auto & positions = surfaceMeshList[lvl]->GetGeometry()->vertexPositions;
+		for (int i = 0; i < static_cast<int>(nextIndices.size()); ++i)
+		{
+			positions[nextIndices[i]] += nextDeltas[i];
+		}
+		surfaceMeshList[lvl]->UpdatePositions(nextIndices, outDirtyTriangles);
+		displacementFields[lvl].MarkChanged(nextIndices, nextDeltas);
 	}
+}
 
-	meshRenderer->UpdateGeometry(surfaceMeshList[subdivisionLevel]);
-	meshCollisionTriangles = meshRenderer->GetCollisionTriangles(meshModelMat);
+//-----------------------------------------------------
+
+void CC_SubdivisionApp::CancelDeformation(bool const waitForJob)
+{
+	if (deformationJob == nullptr)
+	{
+		return;
+	}
+
+	deformationJob->cancelRequested.store(true);
+	if (waitForJob == true)
+	{
+		deformationJob->future.wait();
+		RevertPreview(*deformationJob);
+		deformationJob = nullptr;
+	}
 }
 
 //-----------------------------------------------------
@@ -648,34 +877,38 @@ void CC_SubdivisionApp::PerformRaycast()
 	glm::dvec3 trianglePosition{};
 	glm::dvec3 triangleNormal{};
 
-	std::vector<CollisionTriangle>* collisionTriangles = nullptr;
-	bool checkForBackCollision = false;
+	bool hasCollision = false;
 	switch (drawMode)
 	{
 	case DrawMode::OnCurtain:
 	{
-		collisionTriangles = &curtainCollisionTriangles;
-		checkForBackCollision = true;
+		hasCollision = Collision::HasContiniousCollision(
+			curtainCollisionTriangles,
+			worldMousePos,
+			worldMousePos + (cameraDirection * 1000.0f),
+			triangleIdx,
+			trianglePosition,
+			triangleNormal,
+			true
+		);
 	}
 	break;
 	case DrawMode::OnMesh:
 	{
-		collisionTriangles = &meshCollisionTriangles;
-		checkForBackCollision = false;
+		hasCollision = Collision::HasContiniousCollision(
+			meshCollisionBVH,
+			meshCollisionMesh,
+			worldMousePos,
+			worldMousePos + (cameraDirection * 1000.0f),
+			triangleIdx,
+			trianglePosition,
+			triangleNormal,
+			false
+		);
 	}
 	break;
 	}
 
-	auto const hasCollision = Collision::HasContiniousCollision(
-		*collisionTriangles,
-		worldMousePos,
-		worldMousePos + (cameraDirection * 1000.0f),
-		triangleIdx,
-		trianglePosition,
-		triangleNormal,
-		checkForBackCollision
-	);
-
 	if (hasCollision == true)
 	{
 		rayCastPoints.emplace_back(trianglePosition);
@@ -686,252 +919,6 @@ void CC_SubdivisionApp::PerformRaycast()
 
 //-----------------------------------------------------
 
-void CC_SubdivisionApp::ProjectCurtainPoints()
-{
-	std::vector<glm::vec3> projDirections{};
-	for (auto const rayCastTriIndex : rayCastTriIndices)
-	{
-		projDirections.emplace_back(curtainRenderer->GetTriangleProjectionDirection(rayCastTriIndex));
-	}
-
-	ClearSamplePoints();
-
-	std::vector<glm::vec3> allSampledPoints{};
-	std::vector<glm::vec3> allSampledNormals{};
-
-	Curve::UniformSample(
-		rayCastPoints,
-		projDirections,
-		allSampledPoints,
-		allSampledNormals,
-		deltaS
-	);
-
-	ClearPorjectedPoints();
-
-	for (int i = 0; i < static_cast<int>(allSampledPoints.size()); ++i)
-	{
-		auto const prevPoint = allSampledPoints[i];
-		auto const nextPoint = allSampledPoints[i] + (allSampledNormals[i] * 1000.0f);
-
-		int triIdx{};
-		glm::dvec3 colPosition{};
-		glm::dvec3 colNormal{};
-
-		auto const hasCollision = Collision::HasContiniousCollision(
-			meshCollisionTriangles,
-			prevPoint,
-			nextPoint,
-			triIdx,
-			colPosition,
-			colNormal,
-			false
-		);
-
-		if (hasCollision == true)
-		{
-			projPoints.emplace_back(colPosition);
-			projNormals.emplace_back(colNormal);
-			projTriIndices.emplace_back(triIdx);
-
-			sampledPoints.emplace_back(allSampledPoints[i]);
-			sampledNormals.emplace_back(allSampledNormals[i]);
-		}
-	}
-}
-
-//-----------------------------------------------------
-
-void CC_SubdivisionApp::CalcVertexToPointContribution(
-	std::vector<glm::vec3>& outVertices,
-	std::vector<int>& outVertexIndices,
-	std::vector<std::tuple<int, int, float>>& outVToPContrib
-) const
-{
-	std::vector<std::tuple<int, int, float>> vToPContrib{};
-
-	std::unordered_map<int, int> vGtoLIdx{}; // Vertex global to local idx
-	std::vector<int> lToGIdx{};
-	std::vector<int> prevLToGIdx{};
-
-	auto Clear = [&]()->void
-	{
-		prevLToGIdx = lToGIdx;
-		vGtoLIdx.clear();
-		lToGIdx.clear();
-	};
-
-	auto FindOrInsertVertex = [&](int globalIdx)->int
-	{
-		auto const findResult = vGtoLIdx.find(globalIdx);
-		if (findResult != vGtoLIdx.end())
-		{
-			return findResult->second;
-		}
-
-		int const localIdx = lToGIdx.size();
-		vGtoLIdx[globalIdx] = localIdx;
-		lToGIdx.emplace_back(globalIdx);
-
-		return localIdx;
-	};
-
-	
-	for (int pIdx = 0; pIdx < static_cast<int>(projPoints.size()); ++pIdx)
-	{
-		int const triangleIdx = projTriIndices[pIdx];
-
-		auto const& triangle = meshCollisionTriangles[triangleIdx];
-
-		auto const& v0 = triangle.edgeVertices[0];
-		auto const& v1 = triangle.edgeVertices[1];
-		auto const& v2 = triangle.edgeVertices[2];
-
-		std::tuple<int, int, int> vIds {};
-		auto const foundVertices = surfaceMeshList[subdivisionLevel]->GetVertexIndices(triangleIdx, vIds);
-		MFA_ASSERT(foundVertices == true);
-		auto& [idx0, idx1, idx2] = vIds;
-
-		auto const coordinate = Math::CalcBarycentricCoordinate(
-			projPoints[pIdx],
-			v0,
-			v1,
-			v2
-		);
-
-		vToPContrib.emplace_back(std::tuple{ FindOrInsertVertex(idx0), pIdx, coordinate.x });
-		vToPContrib.emplace_back(std::tuple{ FindOrInsertVertex(idx1), pIdx, coordinate.y });
-		vToPContrib.emplace_back(std::tuple{ FindOrInsertVertex(idx2), pIdx, coordinate.z });
-	}
-
-	for (int i = 0; i < numberOfEffectLevels; ++i)
-	{
-		Clear();
-
-		int currLvlIdx = subdivisionLevel - i;
-		int prevLvlIdx = subdivisionLevel - i - 1;
-
-		std::vector<std::tuple<int, int, float>> newVToPGContrib{};
-		for (auto const& [lIdx, pIdx, value] : vToPContrib)
-		{
-			auto const & contribs = contributionMapList[prevLvlIdx]->GetNextLvlContribs(prevLToGIdx[lIdx]);
-			for (auto const & contrib : contribs)
-			{
-				newVToPGContrib.emplace_back(std::tuple{ FindOrInsertVertex(contrib->prevLvlVIdx), pIdx, contrib->amount * value });
-			}
-		}
-
-		vToPContrib = newVToPGContrib;
-	}
-	outVToPContrib = vToPContrib;
-
-	auto const lvlVertices = surfaceMeshList[subdivisionLevel - numberOfEffectLevels]->GetVertices();
-	outVertexIndices = lToGIdx;
-	for (auto gIdx : lToGIdx)
-	{
-		outVertices.emplace_back(lvlVertices[gIdx].position);
-	}
-}
-
-//-----------------------------------------------------
-
-void CC_SubdivisionApp::CalcLaplacianContribution(
-	std::vector<glm::vec3> & movableVertices,
-	std::vector<int> & vertexGIndices,
-	std::vector<glm::vec3> & allVertices,													// All vertices must contain movable vertices as well
-	std::vector<std::tuple<int, int, float>> & vToVContrib,									// For laplacian
-	std::unordered_map<int, glm::vec3> & localIdxToLaplacian
-)
-{
-	std::unordered_map<int, int> gToLVMap{};												// Global to local vertex map
-	for (int lIdx = 0; lIdx < static_cast<int>(vertexGIndices.size()); ++lIdx)
-	{
-		auto wIdx = vertexGIndices[lIdx];
-		MFA_ASSERT(gToLVMap.contains(wIdx) == false);
-		gToLVMap[wIdx] = lIdx;
-	}
-
-	auto const& meshSurface = surfaceMeshList[subdivisionLevel - numberOfEffectLevels];
-
-	// Local index to laplacian
-	{
-		std::vector<int> queryIndices = vertexGIndices;
-		for (int itrCount = 0; itrCount < laplacianDistance; ++itrCount)
-		{
-			std::vector<int> nextQueryIndices{};
-			for (auto myGIdx : queryIndices)
-			{
-				MFA_ASSERT(gToLVMap.contains(myGIdx));
-				auto myLIdx = gToLVMap[myGIdx];
-
-				std::set<int> allVertexNeighbors{};
-				{
-					bool result = meshSurface->GetVertexNeighbors(myGIdx, allVertexNeighbors);
-					MFA_ASSERT(result == true);
-				}
-
-				glm::vec3 laplacian = allVertices[myLIdx];
-				bool isMovable = itrCount < laplacianDistance - 1;
-				bool canInsert = itrCount < laplacianDistance;
-
-				std::vector<int> validNeighbors{};
-				for (auto& neighGIdx : allVertexNeighbors)
-				{
-					auto const findLIdResult = gToLVMap.find(neighGIdx);
-					if (findLIdResult == gToLVMap.end())
-					{
-						if (canInsert == true)
-						{
-							glm::vec3 position = {};
-							{
-								bool result = meshSurface->GetVertexPosition(neighGIdx, position);
-								MFA_ASSERT(result == true);
-							}
-
-							auto const neighLIdx = static_cast<int>(allVertices.size());
-							if (isMovable == true)
-							{
-								movableVertices.emplace_back(position);
-							}
-							allVertices.emplace_back(position);
-							vertexGIndices.emplace_back(neighGIdx);
-							nextQueryIndices.emplace_back(neighGIdx);
-							gToLVMap[neighGIdx] = neighLIdx;
-
-							validNeighbors.emplace_back(neighGIdx);
-						}
-					}
-					else
-					{
-						validNeighbors.emplace_back(neighGIdx);
-					}
-				}
-
-				float weight = 1.0f / static_cast<float>(validNeighbors.size());
-
-				for (auto& neighGIdx : validNeighbors)
-				{
-					auto const findLIdResult = gToLVMap.find(neighGIdx);
-
-					if (findLIdResult != gToLVMap.end())
-					{
-						auto const neighLIdx = findLIdResult->second;
-						laplacian -= weight * allVertices[neighLIdx];
-						vToVContrib.emplace_back(std::tuple{ neighLIdx, myLIdx, -weight });
-					}
-				}
-
-				vToVContrib.emplace_back(std::tuple{ myLIdx, myLIdx, 1.0f });
-
-				localIdxToLaplacian[myLIdx] = laplacian;
-			}
-			queryIndices = nextQueryIndices;
-		}
-	}
-}
-
-//-----------------------------------------------------
-
 void CC_SubdivisionApp::ClearRaycastPoints()
 {
 	rayCastPoints.clear();
@@ -17,10 +17,17 @@
 #include "camera/ObserverCamera.hpp"
 #include "utils/LineRenderer.hpp"
 #include "CurtainMeshRenderer.hpp"
+#include "JobSystem.hpp"
 
+#include <atomic>
+#include <future>
 #include <memory>
 
 #include "Contribution.hpp"
+#include "DeformationEngine.hpp"
+#include "DisplacementField.hpp"
+#include "PositionSnapshot.hpp"
+#include "SubdivisionCache.hpp"
 
 class CC_SubdivisionApp
 {
@@ -30,6 +37,8 @@ public:
 	using Geometry = geometrycentral::surface::VertexPositionGeometry;
 	using MeshRenderer = shared::SurfaceMeshRenderer;
 	using CollisionTriangle = MFA::CollisionTriangle;
+	using CollisionMesh = MFA::CollisionMesh;
+	using CollisionBVH = MFA::CollisionBVH;
 	using CurtainRenderer = shared::CurtainMeshRenderer;
 	using CameraBufferTracker = MFA::HostVisibleBufferTracker<MFA::ColorPipeline::ViewProjection>;
 
@@ -51,8 +60,36 @@ private:
 
 	void ClearCurtain();
 
+	// Starts the solve on a worker thread, the current geometry is displayed until the result is applied
 	void DeformMesh();
 
+	// Applies the result of a finished solve, runs on the main thread
+	void UpdateDeformation();
+
+	void ApplyDeformation(bool deformed, shared::DeformationEngine::Result & result);
+
+	// Moves every level of the displacements by their delta and updates the displayed level
+	void ApplyDisplacements(std::vector<shared::DeformationEngine::LevelDisplacement> const & displacements);
+
+	void UndoDeformation();
+
+	void RedoDeformation();
+
+	// Moves vertices of a level and syncs the levels up to the displayed one
+	void MoveVertices(
+		int lvl,
+		std::vector<int> const & vertexIndices,
+		std::vector<geometrycentral::Vector3> const & deltas
+	);
+
+	// Propagates the pending changes of every level to the next one, up to toLevel.
+	// Outputs the dirty triangles of the last level that changed.
+	void SyncLevels(int toLevel, std::vector<int> & outDirtyTriangles);
+
+	// The result of a cancelled solve is discarded. Waiting is required before the hierarchy is modified, the
+	// solvers poll the cancel flag every iteration so the wait is bounded by a single sparse factorization.
+	void CancelDeformation(bool waitForJob);
+
 	void DrawPoints(
 		MFA::RT::CommandRecordState& recordState,
 		std::vector<glm::vec3> const& points,
@@ -62,22 +99,6 @@ private:
 
 	void PerformRaycast();
 
-	void ProjectCurtainPoints();
-
-	void CalcVertexToPointContribution(
-		std::vector<glm::vec3>& outVertices,
-		std::vector<int>& outVertexIndices,
-		std::vector<std::tuple<int, int, float>>& outVToPContrib
-	) const;
-
-	void CalcLaplacianContribution(
-		std::vector<glm::vec3> & movableVertices,
-		std::vector<int> & vertexGIndices,
-		std::vector<glm::vec3> & allVertices,									// All vertices must contain movable vertices as well
-		std::vector<std::tuple<int, int, float>> & vToVContrib,
-		std::unordered_map<int, glm::vec3> & localIdxToLaplacian
-	);
-
 	void ClearRaycastPoints();
 
 	void ClearPorjectedPoints();
@@ -88,6 +109,7 @@ private:
 
 	// Render parameters
 	std::shared_ptr<MFA::Path> path{};
+	std::shared_ptr<MFA::JobSystem> jobSystem{};
 	std::shared_ptr<MFA::LogicalDevice> device{};
 	std::shared_ptr<MFA::UI> ui{};
 	std::shared_ptr<MFA::SwapChainRenderResource> swapChainResource{};
@@ -123,11 +145,52 @@ private:
 	int subdivisionLevel = 0;
 	float curtainHeight = 0.5f;
 	float deltaS = 0.001f;
+	// Output is identical in both modes, the serial mode is kept for profiling
+	bool parallelSubdivision = true;
+	// Deep levels keep their stencils in the compressed layout which is several times smaller but slower to read
+	int compressStencilsFromLvl = 6;
+	// Iterative solver that uses the coarser levels as multigrid hierarchy, scales to large regions
+	bool useMultigridSolver = false;
+	// Keeps the shape of the region rigid instead of only smooth, ignores the solver choice
+	bool useArap = false;
+	int arapIterations = 5;
+	// A fit this many levels coarser is shown while the exact one is solved in the background
+	int previewLevels = 2;
 
 	std::vector<std::shared_ptr<shared::ContributionMap>> contributionMapList{};
 	std::vector<std::shared_ptr<shared::SurfaceMesh>> surfaceMeshList{};
-	std::vector<bool> subdivisionDirtyStatus{};
-	std::unordered_map<int, std::vector<std::tuple<int, geometrycentral::Vector3>>> deformationsPerLvl{};
+	// Edits of each level and the changes that the finer levels have not received yet
+	std::vector<shared::DisplacementField> displacementFields{};
+	// Level of every edit in the order they were made, edits of one level are kept by its field
+	std::vector<int> undoLevels{};
+	// Older edits stay applied but can no longer be undone, which keeps the history from growing with every stroke
+	int maxUndoCount = 32;
+	std::vector<int> redoLevels{};
+	std::unique_ptr<shared::SubdivisionCache> subdivisionCache{};
+	// Keeps the stencil operators and factorizations of previous strokes
+	shared::DeformationEngine deformationEngine{};
+
+	// Solve that runs in the background. The input only points to the hierarchy, so the levels up to the
+	// drawn one are not modified until the job has finished.
+	struct DeformationJob
+	{
+		shared::DeformationEngine::Input input{};
+		shared::DeformationEngine::Parameters parameters{};
+		shared::DeformationEngine::Result result{};
+		bool deformed = false;
+		std::atomic<bool> cancelRequested{false};
+		std::atomic<float> progress{0.0f};
+		std::future<void> future{};
+		// Coarse result that is displayed while the exact one is solved
+		shared::DeformationEngine::Result preview{};
+		std::atomic<bool> previewReady{false};
+		bool previewApplied = false;
+		// Positions that the preview moved, reverting restores them so the exact result starts from the same mesh
+		shared::PositionSnapshot previewPositions{};
+	};
+	std::shared_ptr<DeformationJob> deformationJob{};
+
+	void RevertPreview(DeformationJob & job);
 
 	bool rightMouseDown = false;
 	// This points are stored globally for better debugging and possible memory reuse.
@@ -142,7 +205,9 @@ private:
 	std::vector<glm::vec3> sampledPoints{};
 	std::vector<glm::vec3> sampledNormals{};
 
-	std::vector<CollisionTriangle> meshCollisionTriangles{};
+	CollisionMesh meshCollisionMesh{};
+	// Rebuilt when the level changes and refitted after every deformation
+	CollisionBVH meshCollisionBVH{};
 	std::vector<CollisionTriangle> curtainCollisionTriangles{};
 	
 	enum class DrawMode
@@ -163,4 +228,6 @@ private:
 	float laplacianWeight = 0.9f;
 
 	int numberOfEffectLevels = 0;
+	// Samples of a stroke that are closer than this on the same triangle become a single constraint
+	float constraintMergeDistance = 0.0f;
 };
@@ -0,0 +1,286 @@
+#include "BedrockLog.hpp"
+#include "BedrockPath.hpp"
+#include "Collision.hpp"
+#include "StaticTriangleGrid.hpp"
+#include "Subdivision.hpp"
+#include "TriangleBVH.hpp"
+
+#include "geometrycentral/surface/meshio.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace geometrycentral::surface;
+
+using namespace MFA;
+using namespace shared;
+
+// Usage: CollisionBenchmark [maxLevel] [rayCount] [model relative to the asset folder]
+// Casts the same rays against every Catmull-Clark level with the linear scan, the BVH and the uniform grid.
+// The linear scan only runs a subset of the rays, the accelerated results are checked against it.
+
+//-----------------------------------------------------
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	constexpr int LinearRayCount = 32;
+
+	struct Ray
+	{
+		glm::dvec3 prevPos{};
+		glm::dvec3 nextPos{};
+	};
+
+	struct Hit
+	{
+		bool hasCollision = false;
+		int triangleIdx = -1;
+		glm::dvec3 position{};
+		glm::dvec3 normal{};
+	};
+
+	//-----------------------------------------------------
+
+	double ElapsedMs(Clock::time_point const start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	//-----------------------------------------------------
+
+	// Quads are split along their corner 0 - corner 2 diagonal like the surface mesh does
+	CollisionMesh GenerateCollisionMesh(
+		ManifoldSurfaceMesh & mesh,
+		VertexPositionGeometry const & geo
+	)
+	{
+		CollisionMesh result{};
+		result.positions.resize(mesh.nVertices());
+		for (auto vertex : mesh.vertices())
+		{
+			auto const & position = geo.inputVertexPositions[vertex];
+			result.positions[vertex.getIndex()] = glm::dvec3{ position.x, position.y, position.z };
+		}
+
+		result.triangles.reserve(mesh.nFaces() * 2);
+		for (auto face : mesh.faces())
+		{
+			std::vector<int> corners{};
+			for (auto vertex : face.adjacentVertices())
+			{
+				corners.emplace_back(static_cast<int>(vertex.getIndex()));
+			}
+			for (int i = 1; i + 1 < static_cast<int>(corners.size()); ++i)
+			{
+				result.triangles.emplace_back(corners[0], corners[i], corners[i + 1]);
+			}
+		}
+		return result;
+	}
+
+	//-----------------------------------------------------
+
+	// The list that the linear scan works on
+	std::vector<CollisionTriangle> GenerateCollisionTriangles(CollisionMesh const & mesh)
+	{
+		std::vector<CollisionTriangle> triangles(mesh.triangles.size());
+		#pragma omp parallel for
+		for (int i = 0; i < static_cast<int>(triangles.size()); ++i)
+		{
+			triangles[i] = Collision::GenerateCollisionTriangle(mesh, i);
+		}
+		return triangles;
+	}
+
+	//-----------------------------------------------------
+
+	// Rays start on a sphere around the model and aim at its inner half, most of them hit it
+	std::vector<Ray> GenerateRays(VertexPositionGeometry const & geo, int const rayCount)
+	{
+		glm::dvec3 min{ std::numeric_limits<double>::max() };
+		glm::dvec3 max{ std::numeric_limits<double>::lowest() };
+		for (auto const & position : geo.inputVertexPositions.raw())
+		{
+			min = glm::min(min, glm::dvec3{ position.x, position.y, position.z });
+			max = glm::max(max, glm::dvec3{ position.x, position.y, position.z });
+		}
+		auto const center = (min + max) * 0.5;
+		auto const radius = glm::length(max - min);
+
+		std::mt19937 generator{ 1234 };
+		std::uniform_real_distribution<double> distribution{ -1.0, 1.0 };
+
+		std::vector<Ray> rays(rayCount);
+		for (auto & ray : rays)
+		{
+			glm::dvec3 offset{};
+			do
+			{
+				offset = glm::dvec3{ distribution(generator), distribution(generator), distribution(generator) };
+			} while (glm::length(offset) < 1e-3);
+
+			glm::dvec3 const target{
+				center.x + distribution(generator) * (max.x - min.x) * 0.25,
+				center.y + distribution(generator) * (max.y - min.y) * 0.25,
+				center.z + distribution(generator) * (max.z - min.z) * 0.25
+			};
+
+			ray.prevPos = center + glm::normalize(offset) * radius;
+			ray.nextPos = ray.prevPos + glm::normalize(target - ray.prevPos) * 1000.0;
+		}
+		return rays;
+	}
+
+	//-----------------------------------------------------
+
+	template<typename CastFunction>
+	double CastRays(std::vector<Ray> const & rays, int const rayCount, std::vector<Hit> & outHits, CastFunction const & cast)
+	{
+		outHits.resize(rayCount);
+		auto const start = Clock::now();
+		for (int i = 0; i < rayCount; ++i)
+		{
+			auto & hit = outHits[i];
+			hit.hasCollision = cast(rays[i], hit);
+		}
+		return ElapsedMs(start);
+	}
+
+	//-----------------------------------------------------
+
+	int CountMismatches(std::vector<Hit> const & expected, std::vector<Hit> const & actual)
+	{
+		int mismatchCount = 0;
+		for (int i = 0; i < static_cast<int>(expected.size()); ++i)
+		{
+			if (
+				expected[i].hasCollision != actual[i].hasCollision ||
+				expected[i].triangleIdx != actual[i].triangleIdx ||
+				glm::length(expected[i].position - actual[i].position) > 1e-9
+			)
+			{
+				++mismatchCount;
+			}
+		}
+		return mismatchCount;
+	}
+}
+
+//-----------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	auto const path = Path::Instantiate();
+
+	int const maxLevel = argc > 1 ? std::atoi(argv[1]) : 6;
+	int const rayCount = argc > 2 ? std::max(std::atoi(argv[2]), LinearRayCount) : 10'000;
+	std::string const modelAddress = argc > 3 ? argv[3] : "models/cube.obj";
+
+	auto [baseMesh, baseGeometry] = readManifoldSurfaceMesh(Path::Instance->Get(modelAddress));
+
+	std::shared_ptr<ManifoldSurfaceMesh> mesh = baseMesh->copy();
+	std::shared_ptr<VertexPositionGeometry> geometry = baseGeometry->reinterpretTo(*mesh);
+
+	MFA_LOG_INFO("Benchmarking %s up to level %d with %d rays", modelAddress.c_str(), maxLevel, rayCount);
+
+	for (int lvl = 1; lvl <= maxLevel; ++lvl)
+	{
+		auto result = CatmullClarkSubdivide(*mesh, *geometry, true);
+		// Geometry first, it has to be released before the mesh it refers to
+		geometry = std::move(result.geometry);
+		mesh = std::move(result.mesh);
+
+		auto const collisionMesh = GenerateCollisionMesh(*mesh, *geometry);
+		auto const triangles = GenerateCollisionTriangles(collisionMesh);
+		auto const rays = GenerateRays(*geometry, rayCount);
+
+		std::vector<Hit> linearHits{};
+		auto const linearMs = CastRays(rays, LinearRayCount, linearHits, [&](Ray const & ray, Hit & hit)->bool
+		{
+			return Collision::HasContiniousCollision(
+				triangles, ray.prevPos, ray.nextPos, hit.triangleIdx, hit.position, hit.normal
+			);
+		});
+
+		Collision::TriangleBVH bvh{};
+		auto start = Clock::now();
+		bvh.Build(collisionMesh);
+		auto const bvhBuildMs = ElapsedMs(start);
+
+		std::vector<Hit> bvhHits{};
+		auto const bvhMs = CastRays(rays, rayCount, bvhHits, [&](Ray const & ray, Hit & hit)->bool
+		{
+			return Collision::HasContiniousCollision(
+				bvh, collisionMesh, ray.prevPos, ray.nextPos, hit.triangleIdx, hit.position, hit.normal
+			);
+		});
+
+		Collision::StaticTriangleGrid grid{};
+		start = Clock::now();
+		grid.Build(collisionMesh);
+		auto const gridBuildMs = ElapsedMs(start);
+
+		std::vector<Hit> gridHits{};
+		auto const gridMs = CastRays(rays, rayCount, gridHits, [&](Ray const & ray, Hit & hit)->bool
+		{
+			return Collision::HasContiniousCollision(
+				grid, collisionMesh, ray.prevPos, ray.nextPos, hit.triangleIdx, hit.position, hit.normal
+			);
+		});
+
+		bvhHits.resize(LinearRayCount);
+		gridHits.resize(LinearRayCount);
+
+		auto const hitCount = std::count_if(linearHits.begin(), linearHits.end(), [](Hit const & hit)->bool
+		{
+			return hit.hasCollision;
+		});
+		auto const & resolution = grid.GetResolution();
+
+		auto const triangleListBytes = triangles.size() * sizeof(CollisionTriangle);
+		auto const collisionMeshBytes =
+			collisionMesh.positions.size() * sizeof(glm::dvec3) +
+			collisionMesh.triangles.size() * sizeof(std::tuple<int, int, int>);
+
+		MFA_LOG_INFO(
+			"Level %d: %zu triangles, %d/%d linear rays hit, per ray: linear %.4f ms, bvh %.4f ms, grid %.4f ms",
+			lvl,
+			triangles.size(),
+			static_cast<int>(hitCount),
+			LinearRayCount,
+			linearMs / LinearRayCount,
+			bvhMs / rayCount,
+			gridMs / rayCount
+		);
+		MFA_LOG_INFO(
+			"Level %d: triangle list %.2f MB, collision mesh %.2f MB",
+			lvl,
+			static_cast<double>(triangleListBytes) / (1024.0 * 1024.0),
+			static_cast<double>(collisionMeshBytes) / (1024.0 * 1024.0)
+		);
+		MFA_LOG_INFO(
+			"Level %d: build bvh %.3f ms, grid %.3f ms (%dx%dx%d cells), mismatches bvh %d, grid %d",
+			lvl,
+			bvhBuildMs,
+			gridBuildMs,
+			resolution.x,
+			resolution.y,
+			resolution.z,
+			CountMismatches(linearHits, bvhHits),
+			CountMismatches(linearHits, gridHits)
+		);
+	}
+
+	return 0;
+}
@@ -0,0 +1,308 @@
+#include "BedrockLog.hpp"
+#include "BedrockPath.hpp"
+#include "DeformationEngine.hpp"
+#include "PositionSnapshot.hpp"
+#include "Subdivision.hpp"
+
+#include "geometrycentral/surface/meshio.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace geometrycentral::surface;
+
+using namespace MFA;
+using namespace shared;
+
+// Usage: DeformationBenchmark [drawnLevel] [strokeCount] [model relative to the asset folder]
+// Draws the same strokes on two copies of the hierarchy, one without a preview and one that applies the preview
+// and reverts it before the exact result, like the app does. The final positions of both copies have to be
+// bit-identical at every level.
+
+//-----------------------------------------------------
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	constexpr int PreviewLevels = 2;
+
+	struct Hierarchy
+	{
+		// Meshes first, the geometries have to be released before the meshes they refer to
+		std::vector<std::shared_ptr<ManifoldSurfaceMesh>> meshes{};
+		std::vector<std::shared_ptr<VertexPositionGeometry>> geometries{};
+		DeformationEngine::ContributionMapList contributionMaps{};
+		CollisionMesh collisionMesh{};
+		CollisionBVH collisionBVH{};
+		DeformationEngine engine{};
+	};
+
+	struct Stroke
+	{
+		std::vector<glm::vec3> points{};
+		std::vector<glm::vec3> directions{};
+	};
+
+	struct StrokeTiming
+	{
+		double previewMs = 0.0;
+		double totalMs = 0.0;
+	};
+
+	//-----------------------------------------------------
+
+	double ElapsedMs(Clock::time_point const start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	//-----------------------------------------------------
+
+	// Quads are split along their corner 0 - corner 2 diagonal like the surface mesh does
+	void UpdateCollisionMesh(Hierarchy & hierarchy)
+	{
+		auto & mesh = *hierarchy.meshes.back();
+		auto const & geo = *hierarchy.geometries.back();
+		auto & result = hierarchy.collisionMesh;
+
+		result.positions.resize(mesh.nVertices());
+		for (auto vertex : mesh.vertices())
+		{
+			auto const & position = geo.vertexPositions[vertex];
+			result.positions[vertex.getIndex()] = glm::dvec3{ position.x, position.y, position.z };
+		}
+
+		result.triangles.clear();
+		for (auto const & faceVertices : mesh.getFaceVertexList())
+		{
+			for (int i = 1; i + 1 < static_cast<int>(faceVertices.size()); ++i)
+			{
+				result.triangles.emplace_back(
+					static_cast<int>(faceVertices[0]),
+					static_cast<int>(faceVertices[i]),
+					static_cast<int>(faceVertices[i + 1])
+				);
+			}
+		}
+		hierarchy.collisionBVH.Build(result);
+	}
+
+	//-----------------------------------------------------
+
+	std::unique_ptr<Hierarchy> BuildHierarchy(
+		ManifoldSurfaceMesh & baseMesh,
+		VertexPositionGeometry & baseGeometry,
+		int const drawnLevel
+	)
+	{
+		auto hierarchy = std::make_unique<Hierarchy>();
+		hierarchy->meshes.emplace_back(baseMesh.copy());
+		hierarchy->geometries.emplace_back(baseGeometry.reinterpretTo(*hierarchy->meshes.back()));
+		for (int lvl = 1; lvl <= drawnLevel; ++lvl)
+		{
+			auto result = CatmullClarkSubdivide(*hierarchy->meshes.back(), *hierarchy->geometries.back(), true);
+			hierarchy->meshes.emplace_back(std::move(result.mesh));
+			hierarchy->geometries.emplace_back(std::move(result.geometry));
+			hierarchy->contributionMaps.emplace_back(std::move(result.contributionMap));
+		}
+		UpdateCollisionMesh(*hierarchy);
+		return hierarchy;
+	}
+
+	//-----------------------------------------------------
+
+	// Short strokes slightly above the top of the model that pull the surface up towards them
+	std::vector<Stroke> GenerateStrokes(VertexPositionGeometry const & geo, int const strokeCount)
+	{
+		glm::vec3 min{ std::numeric_limits<float>::max() };
+		glm::vec3 max{ std::numeric_limits<float>::lowest() };
+		for (auto const & position : geo.vertexPositions.raw())
+		{
+			min = glm::min(min, glm::vec3{ position.x, position.y, position.z });
+			max = glm::max(max, glm::vec3{ position.x, position.y, position.z });
+		}
+		auto const extent = max - min;
+
+		std::mt19937 generator{ 1234 };
+		std::uniform_real_distribution<float> distribution{ 0.3f, 0.7f };
+
+		std::vector<Stroke> strokes(strokeCount);
+		for (auto & stroke : strokes)
+		{
+			auto const y = min.y + distribution(generator) * extent.y;
+			auto const z = max.z + extent.z * 0.05f;
+			for (float const t : { 0.3f, 0.5f, 0.7f })
+			{
+				stroke.points.emplace_back(min.x + t * extent.x, y, z);
+				stroke.directions.emplace_back(0.0f, 0.0f, -1.0f);
+			}
+		}
+		return strokes;
+	}
+
+	//-----------------------------------------------------
+
+	void ApplyDisplacements(
+		Hierarchy & hierarchy,
+		std::vector<DeformationEngine::LevelDisplacement> const & displacements
+	)
+	{
+		for (auto const & displacement : displacements)
+		{
+			auto & positions = hierarchy.geometries[displacement.level]->vertexPositions;
+			for (int i = 0; i < static_cast<int>(displacement.vertexIndices.size()); ++i)
+			{
+				positions[displacement.vertexIndices[i]] += displacement.deltas[i];
+			}
+		}
+	}
+
+	//-----------------------------------------------------
+
+	StrokeTiming Deform(
+		Hierarchy & hierarchy,
+		Stroke const & stroke,
+		DeformationEngine::Parameters const & parameters
+	)
+	{
+		DeformationEngine::Input input{
+			.contributionMaps = &hierarchy.contributionMaps,
+			.collisionMesh = &hierarchy.collisionMesh,
+			.collisionBVH = &hierarchy.collisionBVH,
+			.strokePoints = stroke.points,
+			.projectionDirections = stroke.directions
+		};
+		for (int lvl = 0; lvl < static_cast<int>(hierarchy.meshes.size()); ++lvl)
+		{
+			input.levels.emplace_back(DeformationEngine::Level{
+				.mesh = hierarchy.meshes[lvl].get(),
+				.geometry = hierarchy.geometries[lvl].get()
+			});
+		}
+
+		StrokeTiming timing{};
+		auto const start = Clock::now();
+
+		// Applied on the thread of Deform, which the engine allows once the preview is handed out
+		std::vector<DeformationEngine::LevelDisplacement> previewDisplacements{};
+		PositionSnapshot previewPositions{};
+		input.onPreview = [&](DeformationEngine::Result const & preview)->void
+		{
+			timing.previewMs = ElapsedMs(start);
+			previewDisplacements = preview.displacements;
+			for (auto const & displacement : previewDisplacements)
+			{
+				previewPositions.Save(
+					displacement.level,
+					displacement.vertexIndices,
+					hierarchy.geometries[displacement.level]->vertexPositions
+				);
+			}
+			ApplyDisplacements(hierarchy, previewDisplacements);
+		};
+
+		DeformationEngine::Result result{};
+		bool const deformed = hierarchy.engine.Deform(input, parameters, result);
+		timing.totalMs = ElapsedMs(start);
+
+		for (auto const & displacement : previewDisplacements)
+		{
+			previewPositions.Restore(
+				displacement.level,
+				hierarchy.geometries[displacement.level]->vertexPositions
+			);
+		}
+
+		if (deformed == true)
+		{
+			ApplyDisplacements(hierarchy, result.displacements);
+			UpdateCollisionMesh(hierarchy);
+		}
+		return timing;
+	}
+
+	//-----------------------------------------------------
+
+	int CountDifferingVertices(Hierarchy const & expected, Hierarchy const & actual)
+	{
+		int differingCount = 0;
+		for (int lvl = 0; lvl < static_cast<int>(expected.geometries.size()); ++lvl)
+		{
+			auto const & expectedPositions = expected.geometries[lvl]->vertexPositions.raw();
+			auto const & actualPositions = actual.geometries[lvl]->vertexPositions.raw();
+			for (int i = 0; i < static_cast<int>(expectedPositions.size()); ++i)
+			{
+				if (std::memcmp(&expectedPositions[i], &actualPositions[i], sizeof(expectedPositions[i])) != 0)
+				{
+					++differingCount;
+				}
+			}
+		}
+		return differingCount;
+	}
+}
+
+//-----------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	auto const path = Path::Instantiate();
+
+	int const drawnLevel = argc > 1 ? std::max(std::atoi(argv[1]), PreviewLevels + 1) : 4;
+	int const strokeCount = argc > 2 ? std::atoi(argv[2]) : 8;
+	std::string const modelAddress = argc > 3 ? argv[3] : "models/cube.obj";
+
+	auto [baseMesh, baseGeometry] = readManifoldSurfaceMesh(Path::Instance->Get(modelAddress));
+
+	auto exact = BuildHierarchy(*baseMesh, *baseGeometry, drawnLevel);
+	auto previewed = BuildHierarchy(*baseMesh, *baseGeometry, drawnLevel);
+	auto const strokes = GenerateStrokes(*exact->geometries.back(), strokeCount);
+
+	MFA_LOG_INFO(
+		"Benchmarking %s at level %d with %d strokes, preview %d levels below the solved one",
+		modelAddress.c_str(),
+		drawnLevel,
+		strokeCount,
+		PreviewLevels
+	);
+
+	DeformationEngine::Parameters exactParameters{
+		.laplacianDistance = 4,
+		.laplacianWeight = 0.5f,
+		.numberOfEffectLevels = 1
+	};
+	auto previewParameters = exactParameters;
+	previewParameters.previewLevels = PreviewLevels;
+
+	double totalExactMs = 0.0;
+	double totalPreviewMs = 0.0;
+	double totalPreviewedMs = 0.0;
+	for (auto const & stroke : strokes)
+	{
+		totalExactMs += Deform(*exact, stroke, exactParameters).totalMs;
+		auto const timing = Deform(*previewed, stroke, previewParameters);
+		totalPreviewMs += timing.previewMs;
+		totalPreviewedMs += timing.totalMs;
+	}
+
+	auto const differingCount = CountDifferingVertices(*exact, *previewed);
+	MFA_LOG_INFO(
+		"Per stroke: without preview %.3f ms, with preview %.3f ms of which %.3f ms until the preview",
+		totalExactMs / std::max(strokeCount, 1),
+		totalPreviewedMs / std::max(strokeCount, 1),
+		totalPreviewMs / std::max(strokeCount, 1)
+	);
+	MFA_LOG_INFO("Vertices that differ after reverting the preview: %d", differingCount);
+
+	return differingCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,323 @@
+#include "BedrockLog.hpp"
+#include "BedrockPath.hpp"
+#include "QuadGridMesh.hpp"
+#include "Subdivision.hpp"
+
+#include "geometrycentral/surface/meshio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using namespace geometrycentral::surface;
+
+using namespace MFA;
+using namespace shared;
+
+// Usage: SubdivisionBenchmark [maxLevel] [model relative to the asset folder]
+// Times every Catmull-Clark level once with the generic stencils and once with the specialized ones.
+// From level 2 on the same levels are also built as a QuadGridMesh over level 1, checked against the half-edge levels
+// and compared in memory at the last level.
+
+//-----------------------------------------------------
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct LevelTiming
+	{
+		double durationMs = 0.0;
+		SubdivisionResult result{};
+	};
+
+	//-----------------------------------------------------
+
+	LevelTiming TimeLevel(
+		ManifoldSurfaceMesh & mesh,
+		VertexPositionGeometry const & geo,
+		bool const specializedStencils,
+		int const repeatCount
+	)
+	{
+		LevelTiming timing{};
+		timing.durationMs = std::numeric_limits<double>::max();
+		for (int i = 0; i < repeatCount; ++i)
+		{
+			auto const start = Clock::now();
+			timing.result = CatmullClarkSubdivide(mesh, geo, true, specializedStencils);
+			auto const end = Clock::now();
+			timing.durationMs = std::min(
+				timing.durationMs,
+				std::chrono::duration<double, std::milli>(end - start).count()
+			);
+		}
+		return timing;
+	}
+
+	//-----------------------------------------------------
+
+	double CalcMaxDifference(VertexPositionGeometry const & a, VertexPositionGeometry const & b)
+	{
+		auto const & rawA = a.inputVertexPositions.raw();
+		auto const & rawB = b.inputVertexPositions.raw();
+		double maxDifference = 0.0;
+		for (Eigen::Index i = 0; i < rawA.size(); ++i)
+		{
+			auto const diff = rawA[i] - rawB[i];
+			maxDifference = std::max({maxDifference, std::abs(diff.x), std::abs(diff.y), std::abs(diff.z)});
+		}
+		return maxDifference;
+	}
+
+	//-----------------------------------------------------
+
+	// Both levels number their vertices differently, every grid point is matched to the closest vertex of the
+	// half-edge level through a hash grid. Returns infinity if the closest vertices are not a permutation.
+	double CalcMaxDifference(QuadGridMesh const & grid, VertexPositionGeometry const & geo)
+	{
+		auto const & gridPositions = grid.GetPositions();
+		auto const & meshPositions = geo.inputVertexPositions.raw();
+		auto const vertexCount = static_cast<int>(meshPositions.size());
+		if (static_cast<int>(gridPositions.size()) != vertexCount)
+		{
+			return std::numeric_limits<double>::infinity();
+		}
+
+		geometrycentral::Vector3 min{ std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+		geometrycentral::Vector3 max{ std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+		for (int i = 0; i < vertexCount; ++i)
+		{
+			auto const & position = meshPositions[i];
+			min = geometrycentral::Vector3{ std::min(min.x, position.x), std::min(min.y, position.y), std::min(min.z, position.z) };
+			max = geometrycentral::Vector3{ std::max(max.x, position.x), std::max(max.y, position.y), std::max(max.z, position.z) };
+		}
+		auto const extent = std::max({ max.x - min.x, max.y - min.y, max.z - min.z, 1e-12 });
+		auto const cellSize = extent / std::cbrt(static_cast<double>(vertexCount));
+
+		auto const cellOf = [&](geometrycentral::Vector3 const & position)->std::tuple<int64_t, int64_t, int64_t>
+		{
+			return {
+				static_cast<int64_t>(std::floor((position.x - min.x) / cellSize)),
+				static_cast<int64_t>(std::floor((position.y - min.y) / cellSize)),
+				static_cast<int64_t>(std::floor((position.z - min.z) / cellSize))
+			};
+		};
+		auto const keyOf = [](int64_t const x, int64_t const y, int64_t const z)->int64_t
+		{
+			return ((x + 1) << 42) | ((y + 1) << 21) | (z + 1);
+		};
+
+		std::unordered_map<int64_t, std::vector<int>> cells{};
+		for (int i = 0; i < vertexCount; ++i)
+		{
+			auto const [x, y, z] = cellOf(meshPositions[i]);
+			cells[keyOf(x, y, z)].emplace_back(i);
+		}
+
+		std::vector<bool> isMatched(vertexCount, false);
+		double maxDifference = 0.0;
+		for (auto const & position : gridPositions)
+		{
+			auto const [cx, cy, cz] = cellOf(position);
+			int closestIdx = -1;
+			double closestDistance = std::numeric_limits<double>::max();
+			for (int64_t z = cz - 1; z <= cz + 1; ++z)
+			{
+				for (int64_t y = cy - 1; y <= cy + 1; ++y)
+				{
+					for (int64_t x = cx - 1; x <= cx + 1; ++x)
+					{
+						auto const findResult = cells.find(keyOf(x, y, z));
+						if (findResult == cells.end())
+						{
+							continue;
+						}
+						for (auto const vIdx : findResult->second)
+						{
+							auto const distance = geometrycentral::norm(meshPositions[vIdx] - position);
+							if (distance < closestDistance)
+							{
+								closestDistance = distance;
+								closestIdx = vIdx;
+							}
+						}
+					}
+				}
+			}
+			if (closestIdx == -1 || isMatched[closestIdx] == true)
+			{
+				return std::numeric_limits<double>::infinity();
+			}
+			isMatched[closestIdx] = true;
+			maxDifference = std::max(maxDifference, closestDistance);
+		}
+		return maxDifference;
+	}
+
+	//-----------------------------------------------------
+
+	// Connectivity and positions of geometry-central's ManifoldSurfaceMesh: next, vertex and face per halfedge, a
+	// halfedge per vertex and per face. Twins and edges are implicit in a manifold mesh.
+	size_t EstimateHalfEdgeMemory(ManifoldSurfaceMesh const & mesh)
+	{
+		return
+			mesh.nHalfedges() * 3 * sizeof(size_t) +
+			(mesh.nVertices() + mesh.nFaces()) * sizeof(size_t) +
+			mesh.nVertices() * sizeof(geometrycentral::Vector3);
+	}
+
+	//-----------------------------------------------------
+
+	// Builds the triangle list and the neighbour maps that SurfaceMesh keeps for a level and estimates their size.
+	// Hash and tree nodes are counted as their payload plus the pointers of the libstdc++ node layout.
+	size_t EstimateSurfaceMeshMapMemory(ManifoldSurfaceMesh & mesh)
+	{
+		std::vector<std::tuple<int, int, int>> triangles{};
+		std::unordered_map<int, std::vector<int>> vertexNeighbourTriangles{};
+		std::unordered_map<int, std::set<int>> vertexNeighbourVertices{};
+
+		auto const addTriangle = [&](int const idx0, int const idx1, int const idx2)->void
+		{
+			auto const triIdx = static_cast<int>(triangles.size());
+			triangles.emplace_back(idx0, idx1, idx2);
+			for (auto const [a, b, c] : { std::tuple{ idx0, idx1, idx2 }, std::tuple{ idx1, idx2, idx0 }, std::tuple{ idx2, idx0, idx1 } })
+			{
+				vertexNeighbourTriangles[a].emplace_back(triIdx);
+				vertexNeighbourVertices[a].emplace(b);
+				vertexNeighbourVertices[a].emplace(c);
+			}
+		};
+
+		for (auto const & faceVertices : mesh.getFaceVertexList())
+		{
+			auto const v0 = static_cast<int>(faceVertices[0]);
+			auto const v1 = static_cast<int>(faceVertices[1]);
+			auto const v2 = static_cast<int>(faceVertices[2]);
+			addTriangle(v0, v1, v2);
+			if (faceVertices.size() == 4)
+			{
+				addTriangle(v2, static_cast<int>(faceVertices[3]), v0);
+			}
+		}
+
+		constexpr size_t HashNodeOverhead = sizeof(void *);
+		constexpr size_t TreeNodeOverhead = 3 * sizeof(void *) + sizeof(int);
+
+		size_t bytes = triangles.capacity() * sizeof(triangles[0]);
+		bytes += vertexNeighbourTriangles.bucket_count() * sizeof(void *);
+		for (auto const & [vIdx, neighbours] : vertexNeighbourTriangles)
+		{
+			bytes += HashNodeOverhead + sizeof(std::pair<int const, std::vector<int>>) + neighbours.capacity() * sizeof(int);
+		}
+		bytes += vertexNeighbourVertices.bucket_count() * sizeof(void *);
+		for (auto const & [vIdx, neighbours] : vertexNeighbourVertices)
+		{
+			bytes += HashNodeOverhead + sizeof(std::pair<int const, std::set<int>>) + neighbours.size() * (TreeNodeOverhead + sizeof(int));
+		}
+		return bytes;
+	}
+
+	//-----------------------------------------------------
+
+	double ToMegabytes(size_t const bytes)
+	{
+		return static_cast<double>(bytes) / (1024.0 * 1024.0);
+	}
+}
+
+//-----------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	auto const path = Path::Instantiate();
+
+	int const maxLevel = argc > 1 ? std::atoi(argv[1]) : 7;
+	std::string const modelAddress = argc > 2 ? argv[2] : "models/cube.obj";
+
+	auto [baseMesh, baseGeometry] = readManifoldSurfaceMesh(Path::Instance->Get(modelAddress));
+
+	std::shared_ptr<ManifoldSurfaceMesh> mesh = baseMesh->copy();
+	std::shared_ptr<VertexPositionGeometry> geometry = baseGeometry->reinterpretTo(*mesh);
+
+	MFA_LOG_INFO("Benchmarking %s up to level %d", modelAddress.c_str(), maxLevel);
+
+	double totalGenericMs = 0.0;
+	double totalSpecializedMs = 0.0;
+
+	// Level 1 is all quads for any input, the grids start there
+	std::unique_ptr<QuadGridMesh> quadGrid{};
+
+	for (int lvl = 1; lvl <= maxLevel; ++lvl)
+	{
+		// Deep levels take seconds, a single run is enough there
+		int const repeatCount = mesh->nVertices() < 100'000 ? 5 : 1;
+
+		auto generic = TimeLevel(*mesh, *geometry, false, repeatCount);
+		auto specialized = TimeLevel(*mesh, *geometry, true, repeatCount);
+
+		totalGenericMs += generic.durationMs;
+		totalSpecializedMs += specialized.durationMs;
+
+		MFA_LOG_INFO(
+			"Level %d: %zu vertices, generic %.3f ms, specialized %.3f ms, speedup %.2fx, max difference %g",
+			lvl,
+			specialized.result.mesh->nVertices(),
+			generic.durationMs,
+			specialized.durationMs,
+			generic.durationMs / std::max(specialized.durationMs, 1e-6),
+			CalcMaxDifference(*generic.result.geometry, *specialized.result.geometry)
+		);
+
+		// Geometry first, it has to be released before the mesh it refers to
+		geometry = std::move(specialized.result.geometry);
+		mesh = std::move(specialized.result.mesh);
+
+		if (quadGrid == nullptr)
+		{
+			quadGrid = std::make_unique<QuadGridMesh>(*mesh, *geometry);
+			continue;
+		}
+
+		auto const start = Clock::now();
+		quadGrid = quadGrid->Subdivide(true);
+		auto const gridMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		MFA_LOG_INFO(
+			"Level %d: quad grid %.3f ms, max difference to the half-edge level %g",
+			lvl,
+			gridMs,
+			CalcMaxDifference(*quadGrid, *geometry)
+		);
+	}
+
+	if (quadGrid != nullptr && quadGrid->GetResolution() > 1)
+	{
+		auto const halfEdgeBytes = EstimateHalfEdgeMemory(*mesh) + EstimateSurfaceMeshMapMemory(*mesh);
+		auto const gridBytes = quadGrid->GetMemoryUsage();
+		MFA_LOG_INFO(
+			"Level %d memory: half-edge mesh and surface mesh maps %.2f MB, quad grid %.2f MB, ratio %.1fx",
+			maxLevel,
+			ToMegabytes(halfEdgeBytes),
+			ToMegabytes(gridBytes),
+			static_cast<double>(halfEdgeBytes) / static_cast<double>(std::max<size_t>(gridBytes, 1))
+		);
+	}
+
+	MFA_LOG_INFO(
+		"Total: generic %.3f ms, specialized %.3f ms, speedup %.2fx",
+		totalGenericMs,
+		totalSpecializedMs,
+		totalGenericMs / std::max(totalSpecializedMs, 1e-6)
+	);
+
+	return 0;
+}
@@ -4,6 +4,8 @@
 
 #include <ext/scalar_constants.hpp>
 
+#include <algorithm>
+
 using namespace MFA;
 
 namespace shared
@@ -35,29 +37,50 @@ namespace shared
 
     //------------------------------------------------------------
 
-    std::vector<MFA::CollisionTriangle> SurfaceMesh::GetCollisionTriangles(glm::mat4 const & model) const
+    MFA::CollisionMesh SurfaceMesh::GetCollisionMesh(glm::mat4 const & model) const
     {
-        std::vector<CollisionTriangle> result = _collisionTriangles;
+        CollisionMesh result{};
+        result.positions.resize(_vertices.size());
+        result.triangles = _triangles;
 
         #pragma omp parallel for
-        for (int i = 0; i < static_cast<int>(result.size()); ++i)
+        for (int i = 0; i < static_cast<int>(_vertices.size()); ++i)
         {
-            auto& triangle = result[i];
+            result.positions[i] = model * glm::vec4{ _vertices[i].position, 1.0f };
+        }
 
-            triangle.normal = glm::normalize(model * glm::vec4{ triangle.normal, 0.0f });
-            triangle.center = model * glm::vec4{ triangle.center, 1.0f };
+        return result;
+    }
 
-            for (auto& edgeNormal : triangle.edgeNormals)
-            {
-                edgeNormal = glm::normalize(model * glm::vec4{ edgeNormal, 0.0f });
-            }
-            for (auto& edgeVertex : triangle.edgeVertices)
-            {
-                edgeVertex = model * glm::vec4{ edgeVertex, 1.0f };
-            }
+    //------------------------------------------------------------
+
+    void SurfaceMesh::UpdateCollisionMesh(
+        glm::mat4 const & model,
+        std::vector<int> const & triangleIndices,
+        CollisionMesh & inOutMesh
+    ) const
+    {
+        MFA_ASSERT(inOutMesh.positions.size() == _vertices.size());
+        MFA_ASSERT(inOutMesh.triangles.size() == _triangles.size());
+
+        std::vector<int> dirtyVertices{};
+        dirtyVertices.reserve(triangleIndices.size() * 3);
+        for (auto const triIdx : triangleIndices)
+        {
+            auto const& [idx0, idx1, idx2] = _triangles[triIdx];
+            dirtyVertices.emplace_back(idx0);
+            dirtyVertices.emplace_back(idx1);
+            dirtyVertices.emplace_back(idx2);
         }
+        std::sort(dirtyVertices.begin(), dirtyVertices.end());
+        dirtyVertices.erase(std::unique(dirtyVertices.begin(), dirtyVertices.end()), dirtyVertices.end());
 
-        return result;
+        #pragma omp parallel for
+        for (int i = 0; i < static_cast<int>(dirtyVertices.size()); ++i)
+        {
+            auto const vIdx = dirtyVertices[i];
+            inOutMesh.positions[vIdx] = model * glm::vec4{ _vertices[vIdx].position, 1.0f };
+        }
     }
 
     //------------------------------------------------------------
@@ -74,6 +97,13 @@ namespace shared
     
     //------------------------------------------------------------
 
+    std::vector<std::tuple<int, int, int>> const & SurfaceMesh::GetTriangles() const
+    {
+        return _triangles;
+    }
+
+    //------------------------------------------------------------
+
     bool SurfaceMesh::GetVertexNeighbors(int vertexIdx, std::set<int> & outVIds) const
     {
         auto const findResult = _vertexNeighbourVertices.find(vertexIdx);
@@ -123,45 +153,116 @@ namespace shared
     {
         UpdateCpuIndices();
         UpdateCpuVertices();
-        UpdateCollisionTriangles();
     }
 
     //------------------------------------------------------------
 
-    void SurfaceMesh::UpdateCpuVertices()
+    void SurfaceMesh::UpdatePositions()
     {
-        _vertices.clear();
-        _triangleNormals.clear();
+        UpdateCpuVertices();
+    }
 
-        auto const positions = _geometry->vertexPositions.toVector();
+    //------------------------------------------------------------
 
-        for (int i = 0; i < static_cast<int>(_triangles.size()); ++i)
+    void SurfaceMesh::UpdatePositions(
+        std::vector<int> const & dirtyVertices,
+        std::vector<int> & outDirtyTriangles
+    )
+    {
+        outDirtyTriangles.clear();
+        for (auto const vIdx : dirtyVertices)
         {
-            auto const& [idx0, idx1, idx2] = _triangles[i];
+            auto const findResult = _vertexNeighbourTriangles.find(vIdx);
+            if (findResult != _vertexNeighbourTriangles.end())
+            {
+                outDirtyTriangles.insert(outDirtyTriangles.end(), findResult->second.begin(), findResult->second.end());
+            }
+        }
+        std::sort(outDirtyTriangles.begin(), outDirtyTriangles.end());
+        outDirtyTriangles.erase(std::unique(outDirtyTriangles.begin(), outDirtyTriangles.end()), outDirtyTriangles.end());
 
-            glm::vec3 const v0 = glm::vec3{ positions[idx0].x, positions[idx0].y, positions[idx0].z };
-            glm::vec3 const v1 = glm::vec3{ positions[idx1].x, positions[idx1].y, positions[idx1].z };
-            glm::vec3 const v2 = glm::vec3{ positions[idx2].x, positions[idx2].y, positions[idx2].z };
+        #pragma omp parallel for
+        for (int i = 0; i < static_cast<int>(outDirtyTriangles.size()); ++i)
+        {
+            UpdateTriangleNormal(outDirtyTriangles[i]);
+        }
 
-            auto const cross = glm::normalize(glm::cross(v1 - v0, v2 - v1));
+        // Every vertex of a dirty triangle needs a new normal, not only the ones that have moved
+        std::vector<int> normalVertices{};
+        normalVertices.reserve(outDirtyTriangles.size() * 3);
+        for (auto const triIdx : outDirtyTriangles)
+        {
+            auto const& [idx0, idx1, idx2] = _triangles[triIdx];
+            normalVertices.emplace_back(idx0);
+            normalVertices.emplace_back(idx1);
+            normalVertices.emplace_back(idx2);
+        }
+        std::sort(normalVertices.begin(), normalVertices.end());
+        normalVertices.erase(std::unique(normalVertices.begin(), normalVertices.end()), normalVertices.end());
 
-            _triangleNormals.emplace_back(cross);
+        #pragma omp parallel for
+        for (int i = 0; i < static_cast<int>(normalVertices.size()); ++i)
+        {
+            UpdateVertex(normalVertices[i]);
         }
+    }
+
+    //------------------------------------------------------------
+
+    void SurfaceMesh::UpdateCpuVertices()
+    {
+        _triangleNormals.resize(_triangles.size());
+        #pragma omp parallel for
+        for (int i = 0; i < static_cast<int>(_triangles.size()); ++i)
+        {
+            UpdateTriangleNormal(i);
+        }
+
+        _vertices.resize(_geometry->vertexPositions.size());
+        #pragma omp parallel for
+        for (int vIdx = 0; vIdx < static_cast<int>(_vertices.size()); ++vIdx)
+        {
+            UpdateVertex(vIdx);
+        }
+    }
+
+    //------------------------------------------------------------
+
+    void SurfaceMesh::UpdateTriangleNormal(int const triangleIdx)
+    {
+        auto const & positions = _geometry->vertexPositions;
+        auto const& [idx0, idx1, idx2] = _triangles[triangleIdx];
+
+        glm::vec3 const v0 = glm::vec3{ positions[idx0].x, positions[idx0].y, positions[idx0].z };
+        glm::vec3 const v1 = glm::vec3{ positions[idx1].x, positions[idx1].y, positions[idx1].z };
+        glm::vec3 const v2 = glm::vec3{ positions[idx2].x, positions[idx2].y, positions[idx2].z };
+
+        auto const cross = glm::normalize(glm::cross(v1 - v0, v2 - v1));
+
+        _triangleNormals[triangleIdx] = cross;
+    }
 
-        for (int vIdx = 0; vIdx < positions.size(); ++vIdx)
+    //------------------------------------------------------------
+
+    void SurfaceMesh::UpdateVertex(int const vertexIdx)
+    {
+        auto const & position = _geometry->vertexPositions[vertexIdx];
+
+        glm::vec3 normal{};
+        auto const findResult = _vertexNeighbourTriangles.find(vertexIdx);
+        if (findResult != _vertexNeighbourTriangles.end())
         {
-            glm::vec3 normal{};
-            for (auto const& triIdx : _vertexNeighbourTriangles[vIdx])
+            for (auto const& triIdx : findResult->second)
             {
                 normal += _triangleNormals[triIdx];
             }
-            normal = glm::normalize(normal);
-            
-            _vertices.emplace_back(Pipeline::Vertex{
-                .position = glm::vec3 {positions[vIdx].x, positions[vIdx].y, positions[vIdx].z},
-                .normal = normal
-            });
         }
+        normal = glm::normalize(normal);
+
+        _vertices[vertexIdx] = Pipeline::Vertex{
+            .position = glm::vec3 {position.x, position.y, position.z},
+            .normal = normal
+        };
     }
 
     //------------------------------------------------------------
@@ -255,29 +356,6 @@ namespace shared
 
     //------------------------------------------------------------
 
-    void SurfaceMesh::UpdateCollisionTriangles()
-    {
-        _collisionTriangles.resize(_triangles.size());
-        #pragma omp parallel for
-        for (int i = 0; i < static_cast<int>(_triangles.size()); ++i)
-        {
-            auto [idx0, idx1, idx2] = _triangles[i];
-
-            auto const& v0 = _vertices[idx0].position;
-            auto const& v1 = _vertices[idx1].position;
-            auto const& v2 = _vertices[idx2].position;
-
-            Collision::UpdateCollisionTriangle(
-                v0,
-                v1,
-                v2,
-                _collisionTriangles[i]
-            );
-        }
-    }
-
-    //------------------------------------------------------------
-
     std::shared_ptr<SurfaceMesh::Mesh> const& SurfaceMesh::GetMesh()
     {
         return _mesh;
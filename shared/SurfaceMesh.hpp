@@ -15,7 +15,7 @@ namespace shared
 
         using Mesh = geometrycentral::surface::ManifoldSurfaceMesh;
         using Geometry = geometrycentral::surface::VertexPositionGeometry;
-        using CollisionTriangle = MFA::CollisionTriangle;
+        using CollisionMesh = MFA::CollisionMesh;
         using Pipeline = MFA::ColorPipeline;
         using Vertex = Pipeline::Vertex;
         using Index = uint32_t;
@@ -30,11 +30,23 @@ namespace shared
             std::shared_ptr<Geometry> geometry
         );
 
+        // Vertex positions in world space and the triangles of GetTriangles
         [[nodiscard]]
-        std::vector<CollisionTriangle> GetCollisionTriangles(glm::mat4 const & model) const;
+        CollisionMesh GetCollisionMesh(glm::mat4 const & model) const;
+
+        // Refreshes only the vertices of the given triangles in a mesh that was previously returned by GetCollisionMesh
+        void UpdateCollisionMesh(
+            glm::mat4 const & model,
+            std::vector<int> const & triangleIndices,
+            CollisionMesh & inOutMesh
+        ) const;
 
         bool GetVertexIndices(int triangleIdx, std::tuple<int, int, int> & outVIds) const;
 
+        // Vertex indices of every triangle, in the same order as the triangles of the collision mesh
+        [[nodiscard]]
+        std::vector<std::tuple<int, int, int>> const & GetTriangles() const;
+
         bool GetVertexNeighbors(int vertexIdx, std::set<int> & outVIds) const;
 
         bool GetVertexPosition(int vertexIdx, glm::vec3 & outPosition) const;
@@ -43,12 +55,20 @@ namespace shared
 
         void UpdateGeometry();
 
+        // Use when only the vertex positions have changed and the topology is the same
+        void UpdatePositions();
+
+        // Same as UpdatePositions but only touches the given vertices and their one-ring triangles.
+        // Returns the triangles whose normal has been refreshed.
+        void UpdatePositions(
+            std::vector<int> const & dirtyVertices,
+            std::vector<int> & outDirtyTriangles
+        );
+
         void UpdateCpuVertices();
 
         void UpdateCpuIndices();
 
-        void UpdateCollisionTriangles();
-
         [[nodiscard]]
     	std::shared_ptr<Mesh> const& GetMesh();
 
@@ -63,6 +83,10 @@ namespace shared
 
     private:
 
+        void UpdateTriangleNormal(int triangleIdx);
+
+        void UpdateVertex(int vertexIdx);
+
         std::shared_ptr<Mesh> _mesh {};
         std::shared_ptr<Geometry> _geometry {};
         
@@ -73,7 +97,5 @@ namespace shared
         std::unordered_map<int, std::vector<int>> _vertexNeighbourTriangles{};
         std::unordered_map<int, std::set<int>> _vertexNeighbourVertices{};
         std::vector<glm::vec3> _triangleNormals{};
-
-        std::vector<CollisionTriangle> _collisionTriangles{};
     };
 };
\ No newline at end of file
@@ -154,9 +154,9 @@ void shared::SurfaceMeshRenderer::UpdateGeometry(std::shared_ptr<SurfaceMesh> su
 
 //------------------------------------------------------------
 
-std::vector<CollisionTriangle> shared::SurfaceMeshRenderer::GetCollisionTriangles(glm::mat4 const& model) const
+CollisionMesh shared::SurfaceMeshRenderer::GetCollisionMesh(glm::mat4 const& model) const
 {
-	return _surfaceMesh->GetCollisionTriangles(model);
+	return _surfaceMesh->GetCollisionMesh(model);
 }
 
 //------------------------------------------------------------
@@ -16,7 +16,7 @@ namespace shared
         using RecordState = MFA::RT::CommandRecordState;
     	using Mesh = geometrycentral::surface::ManifoldSurfaceMesh;
         using Geometry = geometrycentral::surface::VertexPositionGeometry;
-        using CollisionTriangle = MFA::CollisionTriangle;
+        using CollisionMesh = MFA::CollisionMesh;
         using Index = uint32_t;
 
     	explicit SurfaceMeshRenderer(
@@ -49,7 +49,7 @@ namespace shared
         void UpdateGeometry(std::shared_ptr<SurfaceMesh> surfaceMesh);
 
         [[nodiscard]]
-        std::vector<CollisionTriangle> GetCollisionTriangles(glm::mat4 const& model) const;
+        CollisionMesh GetCollisionMesh(glm::mat4 const& model) const;
 
         bool GetVertexIndices(int triangleIdx, std::tuple<int, int, int> & outVIds) const;
 
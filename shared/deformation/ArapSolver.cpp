@@ -0,0 +1,157 @@
+#include "ArapSolver.hpp"
+
+#include "BedrockAssert.hpp"
+#include "BedrockMath.hpp"
+
+namespace shared
+{
+
+	//-----------------------------------------------------------------------------------------
+
+	ArapSolver::ArapSolver(
+		SparseMatrix const & B,
+		double const laplacianWeight,
+		std::vector<glm::dvec3> const & restPositions,
+		std::vector<std::vector<int>> const & neighbours,
+		int const movableCount,
+		Options const & options
+	)
+		: _options(options)
+		, _movableCount(movableCount)
+	{
+		MFA_ASSERT(B.cols() == movableCount);
+		MFA_ASSERT(restPositions.size() == neighbours.size());
+		MFA_ASSERT(movableCount <= static_cast<int>(restPositions.size()));
+
+		std::vector<Eigen::Triplet<double>> edgeTriplets{};
+		for (int vIdx = 0; vIdx < static_cast<int>(neighbours.size()); ++vIdx)
+		{
+			if (neighbours[vIdx].empty() == true)
+			{
+				continue;
+			}
+			_stars.emplace_back(vIdx);
+			_starBegin.emplace_back(static_cast<int>(_edgeEnds.size()));
+			for (int const nIdx : neighbours[vIdx])
+			{
+				auto const edgeIdx = static_cast<int>(_edgeEnds.size());
+				if (vIdx < movableCount)
+				{
+					edgeTriplets.emplace_back(edgeIdx, vIdx, 1.0);
+				}
+				if (nIdx < movableCount)
+				{
+					edgeTriplets.emplace_back(edgeIdx, nIdx, -1.0);
+				}
+				_edgeEnds.emplace_back(nIdx);
+				_restEdges.emplace_back(restPositions[vIdx] - restPositions[nIdx]);
+			}
+		}
+		_starBegin.emplace_back(static_cast<int>(_edgeEnds.size()));
+
+		_edges.resize(static_cast<int>(_edgeEnds.size()), movableCount);
+		_edges.setFromTriplets(edgeTriplets.begin(), edgeTriplets.end());
+
+		// The rotations only appear on the right hand side
+		_fitTranspose = SparseMatrix(B.transpose()) * (1.0 - laplacianWeight);
+		_edgeTranspose = SparseMatrix(_edges.transpose()) * laplacianWeight;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool ArapSolver::Solve(
+		Eigen::MatrixX3d const & targets,
+		GlobalSolve const & globalSolve,
+		Eigen::MatrixX3d & outX,
+		std::atomic<bool> const * cancelRequested
+	) const
+	{
+		_lastIterationCount = 0;
+		Eigen::MatrixX3d const fitRhs = _fitTranspose * targets;
+
+		// All rotations are the identity at first, which leaves the edge targets at zero
+		outX = Eigen::MatrixX3d::Zero(_movableCount, 3);
+		if (globalSolve(fitRhs, outX) == false)
+		{
+			outX = Eigen::MatrixX3d::Zero(_movableCount, 3);
+			return false;
+		}
+
+		Eigen::MatrixX3d edgeTargets(static_cast<int>(_edgeEnds.size()), 3);
+		for (int itr = 0; itr < _options.maxIterations && IsCancelRequested(cancelRequested) == false; ++itr)
+		{
+			FitRotations(outX, edgeTargets);
+			Eigen::MatrixX3d nextX = outX;
+			if (globalSolve(fitRhs + _edgeTranspose * edgeTargets, nextX) == false)
+			{
+				outX = Eigen::MatrixX3d::Zero(_movableCount, 3);
+				return false;
+			}
+			_lastIterationCount = itr + 1;
+
+			double const change = (nextX - outX).norm();
+			outX = std::move(nextX);
+			if (change <= _options.tolerance * std::max(outX.norm(), 1e-30))
+			{
+				break;
+			}
+		}
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	int ArapSolver::GetLastIterationCount() const
+	{
+		return _lastIterationCount;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	ArapSolver::SparseMatrix const & ArapSolver::GetEdgeMatrix() const
+	{
+		return _edges;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void ArapSolver::FitRotations(Eigen::MatrixX3d const & x, Eigen::MatrixX3d & outEdgeTargets) const
+	{
+		auto const Displacement = [&](int const vIdx)->glm::dvec3
+		{
+			if (vIdx >= _movableCount)
+			{
+				return glm::dvec3{};
+			}
+			return glm::dvec3{x(vIdx, 0), x(vIdx, 1), x(vIdx, 2)};
+		};
+
+		auto const starCount = static_cast<int>(_stars.size());
+		#pragma omp parallel for
+		for (int sIdx = 0; sIdx < starCount; ++sIdx)
+		{
+			auto const center = Displacement(_stars[sIdx]);
+
+			glm::dmat3 covariance{0.0};
+			for (int eIdx = _starBegin[sIdx]; eIdx < _starBegin[sIdx + 1]; ++eIdx)
+			{
+				auto const & restEdge = _restEdges[eIdx];
+				auto const deformedEdge = restEdge + center - Displacement(_edgeEnds[eIdx]);
+				covariance += glm::outerProduct(deformedEdge, restEdge);
+			}
+
+			auto const rotation = MFA::Math::OptimalRotation(covariance);
+			for (int eIdx = _starBegin[sIdx]; eIdx < _starBegin[sIdx + 1]; ++eIdx)
+			{
+				auto const & restEdge = _restEdges[eIdx];
+				auto const target = rotation * restEdge - restEdge;
+				outEdgeTargets(eIdx, 0) = target.x;
+				outEdgeTargets(eIdx, 1) = target.y;
+				outEdgeTargets(eIdx, 2) = target.z;
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
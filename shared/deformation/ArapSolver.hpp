@@ -0,0 +1,86 @@
+#pragma once
+
+#include "LinearSolve.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace shared
+{
+    // As-rigid-as-possible fit of a region to the stroke constraints. Minimizes
+    //      (1 - w) |B x - targets|^2 + w sum_i sum_j |(p'_i - p'_j) - R_i (p_i - p_j)|^2
+    // over the displacements x of the movable vertices, where p' = p + x and R_i is the rotation of the star of i.
+    // Alternates a parallel local step that fits the rotations with a global step whose matrix
+    //      (1 - w) B^T B + w E^T E
+    // does not depend on them. The global step is left to the caller, so its factorization can be cached across
+    // strokes and split into independent blocks; E only depends on the region.
+    class ArapSolver
+    {
+    public:
+
+        using SparseMatrix = SparseSolveMatrix;
+
+        struct Options
+        {
+            int maxIterations = 5;              // Local/global iterations after the initial solve
+            double tolerance = 1e-4;            // Relative change of the displacements that ends the iteration
+        };
+
+        // Solves ((1 - w) B^T B + w E^T E) x = rhs, x holds the previous iterate on entry.
+        // Returns false if the matrix could not be factored.
+        using GlobalSolve = std::function<bool(Eigen::MatrixX3d const & rhs, Eigen::MatrixX3d & inOutX)>;
+
+        // Vertex i of the region rests at restPositions[i], the first movableCount vertices are the unknowns and the
+        // others stay fixed. neighbours[i] is the star of i inside the region, it is empty for vertices whose star
+        // is not part of the energy. B: constraint rows x unknowns.
+        explicit ArapSolver(
+            SparseMatrix const & B,
+            double laplacianWeight,
+            std::vector<glm::dvec3> const & restPositions,
+            std::vector<std::vector<int>> const & neighbours,
+            int movableCount,
+            Options const & options
+        );
+
+        // targets: displacement that each row of B asks for. A cancelled solve stops after the current iteration.
+        // Returns false if the global step failed, outX is zero in that case.
+        [[nodiscard]]
+        bool Solve(
+            Eigen::MatrixX3d const & targets,
+            GlobalSolve const & globalSolve,
+            Eigen::MatrixX3d & outX,
+            std::atomic<bool> const * cancelRequested = nullptr
+        ) const;
+
+        [[nodiscard]]
+        int GetLastIterationCount() const;
+
+        // Edge rows x unknowns, one row per directed edge of the stars
+        [[nodiscard]]
+        SparseMatrix const & GetEdgeMatrix() const;
+
+    private:
+
+        // Rotation of every star for the current displacements, written as (R_i - I) (p_i - p_j) per edge
+        void FitRotations(Eigen::MatrixX3d const & x, Eigen::MatrixX3d & outEdgeTargets) const;
+
+        Options _options{};
+        int _movableCount = 0;
+
+        // Directed edges grouped by their first vertex, edges of _stars[s] are [_starBegin[s], _starBegin[s + 1])
+        std::vector<int> _stars{};
+        std::vector<int> _starBegin{};
+        std::vector<int> _edgeEnds{};
+        std::vector<glm::dvec3> _restEdges{};
+
+        SparseMatrix _edges{};                  // E
+        SparseMatrix _fitTranspose{};           // (1 - w) B^T
+        SparseMatrix _edgeTranspose{};          // w E^T
+
+        mutable int _lastIterationCount = 0;
+
+    };
+}
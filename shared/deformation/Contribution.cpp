@@ -0,0 +1,390 @@
+#include "Contribution.hpp"
+
+#include <ext/scalar_constants.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <omp.h>
+#include <Eigen/src/Core/Matrix.h>
+#include <Eigen/src/Core/util/Constants.h>
+
+#include "BedrockAssert.hpp"
+#include "geometrycentral/utilities/vector3.h"
+
+namespace shared
+{
+
+	//-----------------------------------------------------------------------------------------
+
+	ContributionMap::ContributionMap(
+		Vertices const& prevLvlVs,
+		Vertices const& nextLvlVs,
+		std::vector<ContribTuple> const& prevToNextContrib
+	)
+	{
+		std::vector<Contribution> contribs(prevToNextContrib.size());
+		#pragma omp parallel for
+		for (int i = 0; i < static_cast<int>(prevToNextContrib.size()); ++i)
+		{
+			auto const& [prevLvlPos, nextLvlPos, value] = prevToNextContrib[i];
+
+			auto const prevIdx = prevLvlPos.getIndex();//GetVertexIdx(prevLvlVs, prevLvlPos);
+			auto const nextIdx = nextLvlPos.getIndex();//GetVertexIdx(nextLvlVs, nextLvlPos);
+
+			auto const contribIdx = i;
+
+			contribs[contribIdx] = Contribution{
+				.nextLvlVIdx = static_cast<int>(nextIdx),
+				.prevLvlVIdx = static_cast<int>(prevIdx),
+				.amount = value
+			};
+		}
+
+		BuildIndices(contribs);
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	ContributionMap::ContributionMap(std::vector<Contribution> prevToNextContrib)
+	{
+		BuildIndices(prevToNextContrib);
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void ContributionMap::BuildIndices(std::vector<Contribution> const & contribs)
+	{
+		int prevLvlVCount = 0;
+		int nextLvlVCount = 0;
+		#pragma omp parallel for reduction(max: prevLvlVCount, nextLvlVCount)
+		for (int i = 0; i < static_cast<int>(contribs.size()); ++i)
+		{
+			prevLvlVCount = std::max(prevLvlVCount, contribs[i].prevLvlVIdx + 1);
+			nextLvlVCount = std::max(nextLvlVCount, contribs[i].nextLvlVIdx + 1);
+		}
+		_prevLvlVCount = prevLvlVCount;
+		_nextLvlVCount = nextLvlVCount;
+		_contribCount = contribs.size();
+
+		BuildCompressedRows(
+			contribs, 
+			&Contribution::prevLvlVIdx, 
+			&Contribution::nextLvlVIdx, 
+			_prevLvlVCount, 
+			_prevLvlOffsets, 
+			_prevLvlContribs
+		);
+		BuildCompressedRows(
+			contribs, 
+			&Contribution::nextLvlVIdx, 
+			&Contribution::prevLvlVIdx, 
+			_nextLvlVCount, 
+			_nextLvlOffsets, 
+			_nextLvlContribs
+		);
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void ContributionMap::BuildCompressedRows(
+		std::vector<Contribution> const & contribs,
+		int Contribution::* vertexIdx,
+		int Contribution::* otherVertexIdx,
+		int const vertexCount,
+		std::vector<int> & outOffsets,
+		std::vector<Contribution> & outContribs
+	)
+	{
+		auto const contribCount = static_cast<int>(contribs.size());
+
+		outOffsets.assign(vertexCount + 1, 0);
+		#pragma omp parallel for
+		for (int i = 0; i < contribCount; ++i)
+		{
+			MFA_ASSERT(contribs[i].*vertexIdx >= 0);
+			#pragma omp atomic
+			++outOffsets[contribs[i].*vertexIdx + 1];
+		}
+
+		for (int vIdx = 0; vIdx < vertexCount; ++vIdx)
+		{
+			outOffsets[vIdx + 1] += outOffsets[vIdx];
+		}
+
+		std::vector<int> cursors(outOffsets.begin(), outOffsets.end() - 1);
+		std::vector<int> order(contribCount);
+		#pragma omp parallel for
+		for (int i = 0; i < contribCount; ++i)
+		{
+			int slot;
+			#pragma omp atomic capture
+			slot = cursors[contribs[i].*vertexIdx]++;
+			order[slot] = i;
+		}
+
+		// Slots inside a row are claimed in a racy order, sorting them makes the layout deterministic.
+		// Sorting by the other vertex also keeps the index deltas of the compressed layout small.
+		#pragma omp parallel for schedule(dynamic, 1024)
+		for (int vIdx = 0; vIdx < vertexCount; ++vIdx)
+		{
+			std::sort(
+				order.begin() + outOffsets[vIdx], 
+				order.begin() + outOffsets[vIdx + 1],
+				[&](int const lhs, int const rhs)->bool
+				{
+					auto const lhsOther = contribs[lhs].*otherVertexIdx;
+					auto const rhsOther = contribs[rhs].*otherVertexIdx;
+					return lhsOther != rhsOther ? lhsOther < rhsOther : lhs < rhs;
+				}
+			);
+		}
+
+		outContribs.resize(contribCount);
+		#pragma omp parallel for
+		for (int i = 0; i < contribCount; ++i)
+		{
+			outContribs[i] = contribs[order[i]];
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	std::span<Contribution const> ContributionMap::GetPrevLvlContibs(int const prevGIdx) const
+	{
+		MFA_ASSERT(_isCompressed == false);
+		MFA_ASSERT(prevGIdx >= 0 && prevGIdx < _prevLvlVCount);
+		return std::span<Contribution const>{
+			_prevLvlContribs.data() + _prevLvlOffsets[prevGIdx],
+			_prevLvlContribs.data() + _prevLvlOffsets[prevGIdx + 1]
+		};
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	std::span<Contribution const> ContributionMap::GetNextLvlContribs(int const nextGIdx) const
+	{
+		MFA_ASSERT(_isCompressed == false);
+		MFA_ASSERT(nextGIdx >= 0 && nextGIdx < _nextLvlVCount);
+		return std::span<Contribution const>{
+			_nextLvlContribs.data() + _nextLvlOffsets[nextGIdx],
+			_nextLvlContribs.data() + _nextLvlOffsets[nextGIdx + 1]
+		};
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void ContributionMap::Apply(Vertices const & prevLvlVs, Vertices & nextLvlVs) const
+	{
+		MFA_ASSERT(prevLvlVs.size() >= _prevLvlVCount);
+		MFA_ASSERT(nextLvlVs.size() == _nextLvlVCount);
+
+		// Gathering per next lvl vertex so every output is written by a single thread
+		#pragma omp parallel for
+		for (int nextIdx = 0; nextIdx < _nextLvlVCount; ++nextIdx)
+		{
+			Vector3 position = Vector3::zero();
+			ForEachNextLvlContrib(nextIdx, [&](int const prevIdx, float const amount)->void
+			{
+				position += prevLvlVs[prevIdx] * static_cast<double>(amount);
+			});
+			nextLvlVs[nextIdx] = position;
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void ContributionMap::PropagateDelta(
+		std::vector<int> const & prevLvlVIndices,
+		std::vector<Vector3> const & prevLvlDeltas,
+		std::vector<int> & outNextLvlVIndices,
+		std::vector<Vector3> & outNextLvlDeltas
+	) const
+	{
+		MFA_ASSERT(prevLvlVIndices.size() == prevLvlDeltas.size());
+
+		outNextLvlVIndices.clear();
+		outNextLvlDeltas.clear();
+
+		std::unordered_map<int, int> nextToLocalIdx{};
+		for (int i = 0; i < static_cast<int>(prevLvlVIndices.size()); ++i)
+		{
+			auto const & delta = prevLvlDeltas[i];
+			ForEachPrevLvlContrib(prevLvlVIndices[i], [&](int const nextIdx, float const amount)->void
+			{
+				auto const [itr, inserted] = nextToLocalIdx.try_emplace(
+					nextIdx, 
+					static_cast<int>(outNextLvlVIndices.size())
+				);
+				if (inserted == true)
+				{
+					outNextLvlVIndices.emplace_back(nextIdx);
+					outNextLvlDeltas.emplace_back(Vector3::zero());
+				}
+				outNextLvlDeltas[itr->second] += delta * static_cast<double>(amount);
+			});
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool ContributionMap::Compress()
+	{
+		if (_isCompressed == true)
+		{
+			return true;
+		}
+
+		std::vector<float> weights(_nextLvlContribs.size());
+		#pragma omp parallel for
+		for (int i = 0; i < static_cast<int>(_nextLvlContribs.size()); ++i)
+		{
+			weights[i] = _nextLvlContribs[i].amount;
+		}
+		std::sort(weights.begin(), weights.end());
+		weights.erase(std::unique(weights.begin(), weights.end()), weights.end());
+
+		if (weights.size() > std::numeric_limits<uint16_t>::max() + 1)
+		{
+			return false;
+		}
+
+		EncodeRows(_prevLvlOffsets, _prevLvlContribs, &Contribution::nextLvlVIdx, weights, _prevLvlRows);
+		EncodeRows(_nextLvlOffsets, _nextLvlContribs, &Contribution::prevLvlVIdx, weights, _nextLvlRows);
+		_weights = std::move(weights);
+
+		_prevLvlOffsets = {};
+		_prevLvlContribs = {};
+		_nextLvlOffsets = {};
+		_nextLvlContribs = {};
+		_isCompressed = true;
+
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void ContributionMap::EncodeRows(
+		std::vector<int> const & offsets,
+		std::vector<Contribution> const & contribs,
+		int Contribution::* otherVertexIdx,
+		std::vector<float> const & weights,
+		EncodedRows & outRows
+	)
+	{
+		auto const rowCount = static_cast<int>(offsets.size()) - 1;
+
+		// Returns the number of written bytes, only counts them if dst is null
+		auto const EncodeRow = [&](int const rowIdx, uint8_t * dst)->size_t
+		{
+			size_t size = 0;
+			int64_t prevVIdx = rowIdx;
+			for (int i = offsets[rowIdx]; i < offsets[rowIdx + 1]; ++i)
+			{
+				auto const & contrib = contribs[i];
+
+				auto const code = static_cast<uint16_t>(
+					std::lower_bound(weights.begin(), weights.end(), contrib.amount) - weights.begin()
+				);
+				if (dst != nullptr)
+				{
+					dst[size] = static_cast<uint8_t>(code & 0xFF);
+					dst[size + 1] = static_cast<uint8_t>(code >> 8);
+				}
+				size += 2;
+
+				int64_t const vIdx = contrib.*otherVertexIdx;
+				int64_t const delta = vIdx - prevVIdx;
+				auto zigzag = static_cast<uint64_t>((delta << 1) ^ (delta >> 63));
+				do
+				{
+					auto byte = static_cast<uint8_t>(zigzag & 0x7F);
+					zigzag >>= 7;
+					if (zigzag != 0)
+					{
+						byte |= 0x80;
+					}
+					if (dst != nullptr)
+					{
+						dst[size] = byte;
+					}
+					++size;
+				} while (zigzag != 0);
+
+				prevVIdx = vIdx;
+			}
+			return size;
+		};
+
+		outRows.offsets.assign(rowCount + 1, 0);
+		#pragma omp parallel for
+		for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+		{
+			outRows.offsets[rowIdx + 1] = EncodeRow(rowIdx, nullptr);
+		}
+		for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+		{
+			outRows.offsets[rowIdx + 1] += outRows.offsets[rowIdx];
+		}
+
+		outRows.stream.resize(outRows.offsets.back());
+		#pragma omp parallel for
+		for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+		{
+			EncodeRow(rowIdx, outRows.stream.data() + outRows.offsets[rowIdx]);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool ContributionMap::IsCompressed() const
+	{
+		return _isCompressed;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	size_t ContributionMap::GetContributionCount() const
+	{
+		return _contribCount;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	int ContributionMap::GetPrevLvlVertexCount() const
+	{
+		return _prevLvlVCount;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	int ContributionMap::GetNextLvlVertexCount() const
+	{
+		return _nextLvlVCount;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	int ContributionMap::GetVertexIdx(
+		Vertices const& vertices, 
+		Vector3 const& position
+	)
+	{
+		for (int i = 0; i < static_cast<int>(vertices.size()); ++i)
+		{
+			auto const distance2 =
+				std::pow(vertices[i].x - position.x, 2) +
+				std::pow(vertices[i].y - position.y, 2) +
+				std::pow(vertices[i].z - position.z, 2);
+
+			if (distance2 < glm::epsilon<float>() * glm::epsilon<float>())
+			{
+				return i;
+			}
+		}
+		MFA_ASSERT(false);
+		return -1;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <tuple>
+#include <unordered_map>
+#include <Eigen/Eigen>
+
+#include <geometrycentral/utilities/vector3.h>
+
+#include "geometrycentral/surface/halfedge_element_types.h"
+
+namespace shared
+{
+    using Vector3 = geometrycentral::Vector3;
+    using Vertex = geometrycentral::surface::Vertex;
+    // TODO: Rewrite this in a more meaningful well
+    using ContribTuple = std::tuple<Vertex, Vertex, float>;   //Old v to new V
+
+    struct Contribution
+    {
+    public:
+        int nextLvlVIdx = -1;			// Next level vertex idx
+        int prevLvlVIdx = -1;			// Prev level vertex idx
+        float amount = 0.0f;			// Contribution amount
+    };
+
+    class ContributionMap
+    {
+    public:
+
+        using Vertices = Eigen::Matrix<Vector3, Eigen::Dynamic, 1>;
+
+        explicit ContributionMap(
+            Vertices const& prevLvlVs,                                           // Previous lvl vertices
+            Vertices const & nextLvlVs,                                           // Next lvl vertices
+            std::vector<ContribTuple> const & prevToNextContrib      // Prev lvl to next lvl contribution
+        );
+
+        explicit ContributionMap(std::vector<Contribution> prevToNextContrib);
+
+        // Only available while the map is not compressed, use the ForEach functions otherwise
+        [[nodiscard]]
+        std::span<Contribution const> GetPrevLvlContibs(int prevGIdx) const;
+
+        [[nodiscard]]
+        std::span<Contribution const> GetNextLvlContribs(int nextGIdx) const;
+
+        // Callback signature: void(int prevLvlVIdx, float amount)
+        template<typename Callback>
+        void ForEachNextLvlContrib(int nextGIdx, Callback && callback) const;
+
+        // Callback signature: void(int nextLvlVIdx, float amount)
+        template<typename Callback>
+        void ForEachPrevLvlContrib(int prevGIdx, Callback && callback) const;
+
+        // Visits every contribution ordered by next lvl vertex. Callback signature: void(Contribution const &)
+        template<typename Callback>
+        void ForEachContribution(Callback && callback) const;
+
+        // Replaces both contribution arrays with byte streams. Every entry becomes a 16 bit code into the table of
+        // distinct weights followed by the zigzag varint delta of its vertex idx. Weights stay exact.
+        // Returns false and keeps the plain layout if the map has too many distinct weights.
+        bool Compress();
+
+        [[nodiscard]]
+        bool IsCompressed() const;
+
+        // Re-evaluates next lvl positions from prev lvl positions without touching the topology.
+        // Equivalent to a sparse matrix-vector product with the cached stencils.
+        void Apply(Vertices const & prevLvlVs, Vertices & nextLvlVs) const;
+
+        // Scatters the displacement of a few prev lvl vertices to the next lvl vertices that they contribute to.
+        // Cost is proportional to the number of dirty vertices, output order only depends on the input order.
+        void PropagateDelta(
+            std::vector<int> const & prevLvlVIndices,
+            std::vector<Vector3> const & prevLvlDeltas,
+            std::vector<int> & outNextLvlVIndices,
+            std::vector<Vector3> & outNextLvlDeltas
+        ) const;
+
+        [[nodiscard]]
+        size_t GetContributionCount() const;
+
+        [[nodiscard]]
+        int GetPrevLvlVertexCount() const;
+
+        [[nodiscard]]
+        int GetNextLvlVertexCount() const;
+
+    private:
+
+        void BuildIndices(std::vector<Contribution> const & contribs);
+
+        // Counting sort of the contributions by the given vertex idx. Contributions of the same vertex are sorted by
+        // the other vertex idx and then by input order so the layout does not depend on the number of threads.
+        static void BuildCompressedRows(
+            std::vector<Contribution> const & contribs,
+            int Contribution::* vertexIdx,
+            int Contribution::* otherVertexIdx,
+            int vertexCount,
+            std::vector<int> & outOffsets,
+            std::vector<Contribution> & outContribs
+        );
+
+        struct EncodedRows
+        {
+            std::vector<size_t> offsets{};          // Byte offset of each row inside the stream
+            std::vector<uint8_t> stream{};
+        };
+
+        static void EncodeRows(
+            std::vector<int> const & offsets,
+            std::vector<Contribution> const & contribs,
+            int Contribution::* otherVertexIdx,
+            std::vector<float> const & weights,
+            EncodedRows & outRows
+        );
+
+        // Callback signature: void(int otherVertexIdx, float amount)
+        template<typename Callback>
+        void DecodeRow(EncodedRows const & rows, int rowIdx, Callback && callback) const;
+
+        [[nodiscard]]
+        static int GetVertexIdx(
+            Vertices const& vertices,
+            Vector3 const& position
+        );
+
+        // Compressed sparse rows for both directions, contributions of vertex i are [offsets[i], offsets[i + 1])
+        std::vector<int> _prevLvlOffsets{};
+        std::vector<Contribution> _prevLvlContribs{};
+        std::vector<int> _nextLvlOffsets{};
+        std::vector<Contribution> _nextLvlContribs{};
+
+        // Compressed layout, the plain arrays above are empty when it is in use
+        bool _isCompressed = false;
+        std::vector<float> _weights{};
+        EncodedRows _prevLvlRows{};
+        EncodedRows _nextLvlRows{};
+
+        size_t _contribCount = 0;
+        int _prevLvlVCount = 0;
+        int _nextLvlVCount = 0;
+
+    };
+
+    //-----------------------------------------------------------------------------------------
+
+    template<typename Callback>
+    void ContributionMap::ForEachNextLvlContrib(int const nextGIdx, Callback && callback) const
+    {
+        if (_isCompressed == true)
+        {
+            DecodeRow(_nextLvlRows, nextGIdx, callback);
+            return;
+        }
+        for (auto const & contrib : GetNextLvlContribs(nextGIdx))
+        {
+            callback(contrib.prevLvlVIdx, contrib.amount);
+        }
+    }
+
+    //-----------------------------------------------------------------------------------------
+
+    template<typename Callback>
+    void ContributionMap::ForEachPrevLvlContrib(int const prevGIdx, Callback && callback) const
+    {
+        if (_isCompressed == true)
+        {
+            DecodeRow(_prevLvlRows, prevGIdx, callback);
+            return;
+        }
+        for (auto const & contrib : GetPrevLvlContibs(prevGIdx))
+        {
+            callback(contrib.nextLvlVIdx, contrib.amount);
+        }
+    }
+
+    //-----------------------------------------------------------------------------------------
+
+    template<typename Callback>
+    void ContributionMap::ForEachContribution(Callback && callback) const
+    {
+        for (int nextIdx = 0; nextIdx < _nextLvlVCount; ++nextIdx)
+        {
+            ForEachNextLvlContrib(nextIdx, [&](int const prevIdx, float const amount)->void
+            {
+                callback(Contribution{
+                    .nextLvlVIdx = nextIdx,
+                    .prevLvlVIdx = prevIdx,
+                    .amount = amount
+                });
+            });
+        }
+    }
+
+    //-----------------------------------------------------------------------------------------
+
+    template<typename Callback>
+    void ContributionMap::DecodeRow(EncodedRows const & rows, int const rowIdx, Callback && callback) const
+    {
+        uint8_t const * itr = rows.stream.data() + rows.offsets[rowIdx];
+        uint8_t const * const end = rows.stream.data() + rows.offsets[rowIdx + 1];
+
+        int64_t vIdx = rowIdx;
+        while (itr < end)
+        {
+            uint16_t const code = static_cast<uint16_t>(itr[0] | (itr[1] << 8));
+            itr += 2;
+
+            uint64_t zigzag = 0;
+            int shift = 0;
+            uint8_t byte;
+            do
+            {
+                byte = *itr++;
+                zigzag |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                shift += 7;
+            } while ((byte & 0x80) != 0);
+
+            vIdx += static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+            callback(static_cast<int>(vIdx), _weights[code]);
+        }
+    }
+
+}
@@ -0,0 +1,1054 @@
+#include "DeformationEngine.hpp"
+
+#include "ArapSolver.hpp"
+#include "BedrockAssert.hpp"
+#include "BedrockLog.hpp"
+#include "BedrockMath.hpp"
+#include "Curve.hpp"
+#include "MultigridSolver.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <unordered_map>
+
+namespace shared
+{
+
+	using namespace geometrycentral::surface;
+
+	//-----------------------------------------------------------------------------------------
+
+	namespace
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		double CalcElapsedMs(Clock::time_point const start)
+		{
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	DeformationEngine::DeformationEngine()
+		: _factorizationCache(FactorizationCache::Options{})
+		, _arapFactorizationCache(FactorizationCache::Options{})
+	{}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool DeformationEngine::Deform(Input const & input, Parameters const & parameters, Result & outResult)
+	{
+		MFA_ASSERT(input.levels.empty() == false);
+		MFA_ASSERT(input.contributionMaps != nullptr);
+		MFA_ASSERT(input.collisionMesh != nullptr);
+		MFA_ASSERT(input.collisionMesh->positions.size() == input.levels.back().mesh->nVertices());
+		MFA_ASSERT(input.strokePoints.size() == input.projectionDirections.size());
+
+		outResult = Result{};
+		auto const startTime = Clock::now();
+
+		int const fineLvl = static_cast<int>(input.levels.size()) - 1;
+		int const lvl = fineLvl - parameters.numberOfEffectLevels;
+		MFA_ASSERT(lvl >= 0);
+
+		ProjectCurtainPoints(input, parameters, outResult);
+		ReportProgress(input, 0.3f);
+		if (IsCancelled(input) == true)
+		{
+			outResult = Result{};
+			return false;
+		}
+
+		System system{};
+		AggregateConstraints(parameters, outResult, system);
+
+		// Reads the collision mesh, so it has to be done before the preview is handed out
+		CalcVertexToPointContribution(input, parameters, system);
+		if (system.movableVertices.empty() == true)
+		{
+			return false;
+		}
+
+		// Unknowns shrink by about four per level, so a few levels down the fit is small enough to be shown right away
+		int const previewLvl = std::max(lvl - parameters.previewLevels, 0);
+		bool const hasPreview = input.onPreview != nullptr && previewLvl < lvl;
+		std::unordered_map<int, geometrycentral::Vector3> movedPositions{};
+		if (hasPreview == true)
+		{
+			auto previewParameters = parameters;
+			previewParameters.numberOfEffectLevels = fineLvl - previewLvl;
+			previewParameters.solver = SolverType::Multigrid;
+			previewParameters.model = DeformationModel::Laplacian;
+
+			System previewSystem{};
+			previewSystem.constraints = system.constraints;
+			CalcVertexToPointContribution(input, previewParameters, previewSystem);
+			CalcLaplacianContribution(input.levels[previewLvl], previewParameters, movedPositions, previewSystem);
+
+			Result preview{};
+			Eigen::MatrixX3d previewD{};
+			if (
+				previewSystem.movableVertices.empty() == false &&
+				Solve(input, previewParameters, previewSystem, previewLvl, previewD) == true
+			)
+			{
+				PropagateDisplacements(input, previewSystem, previewLvl, previewD, preview.displacements);
+			}
+			if (IsCancelled(input) == true)
+			{
+				outResult = Result{};
+				return false;
+			}
+
+			if (preview.displacements.empty() == false)
+			{
+				// Only the positions the preview moves can change under the exact assembly, the rest is read as is
+				auto const & positions = input.levels[lvl].geometry->vertexPositions;
+				for (auto const & displacement : preview.displacements)
+				{
+					if (displacement.level != lvl)
+					{
+						continue;
+					}
+					movedPositions.reserve(displacement.vertexIndices.size());
+					for (int const vIdx : displacement.vertexIndices)
+					{
+						movedPositions.emplace(vIdx, positions[vIdx]);
+					}
+				}
+
+				preview.sampledPoints = outResult.sampledPoints;
+				preview.sampledNormals = outResult.sampledNormals;
+				preview.projectedPoints = outResult.projectedPoints;
+				preview.projectedNormals = outResult.projectedNormals;
+				preview.projectedTriangles = outResult.projectedTriangles;
+				input.onPreview(preview);
+				MFA_LOG_INFO(
+					"Preview of %d unknowns at level %d ready after %.1f ms",
+					static_cast<int>(previewSystem.movableVertices.size()),
+					previewLvl,
+					CalcElapsedMs(startTime)
+				);
+			}
+		}
+
+		CalcLaplacianContribution(input.levels[lvl], parameters, movedPositions, system);
+		ReportProgress(input, 0.5f);
+		if (IsCancelled(input) == true)
+		{
+			outResult = Result{};
+			return false;
+		}
+
+		Eigen::MatrixX3d D{};
+		if (Solve(input, parameters, system, lvl, D) == false)
+		{
+			MFA_LOG_WARN("The deformation system could not be factored, the stroke is ignored");
+			outResult = Result{};
+			return false;
+		}
+		ReportProgress(input, 0.9f);
+		if (IsCancelled(input) == true)
+		{
+			outResult = Result{};
+			return false;
+		}
+
+		PropagateDisplacements(input, system, lvl, D, outResult.displacements);
+		ReportProgress(input, 1.0f);
+		MFA_LOG_INFO(
+			"Deformation of %d unknowns at level %d ready after %.1f ms",
+			static_cast<int>(system.movableVertices.size()),
+			lvl,
+			CalcElapsedMs(startTime)
+		);
+
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DeformationEngine::PropagateDisplacements(
+		Input const & input,
+		System const & system,
+		int const level,
+		Eigen::MatrixX3d const & displacements,
+		std::vector<LevelDisplacement> & outDisplacements
+	)
+	{
+		int const fineLvl = static_cast<int>(input.levels.size()) - 1;
+
+		auto & displacement = outDisplacements.emplace_back();
+		displacement.level = level;
+		auto const movableCount = static_cast<int>(system.movableVertices.size());
+		displacement.vertexIndices.resize(movableCount);
+		displacement.deltas.resize(movableCount);
+		for (int i = 0; i < movableCount; ++i)
+		{
+			displacement.vertexIndices[i] = system.vertexGIndices[i];
+			displacement.deltas[i] = geometrycentral::Vector3{
+				displacements(i, 0),
+				displacements(i, 1),
+				displacements(i, 2)
+			};
+		}
+
+		// Finer levels are linear in the coarser ones, so only the vertices reached by the stencils of the
+		// dirty vertices move and they move by the propagated delta.
+		for (int nextLvl = level + 1; nextLvl <= fineLvl; ++nextLvl)
+		{
+			auto const & prevDisplacement = outDisplacements.back();
+			LevelDisplacement nextDisplacement{ .level = nextLvl };
+			(*input.contributionMaps)[nextLvl - 1]->PropagateDelta(
+				prevDisplacement.vertexIndices,
+				prevDisplacement.deltas,
+				nextDisplacement.vertexIndices,
+				nextDisplacement.deltas
+			);
+			outDisplacements.emplace_back(std::move(nextDisplacement));
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DeformationEngine::ClearCaches()
+	{
+		_stencilOperatorCache.Clear();
+		_factorizationCache.Clear();
+		_arapFactorizationCache.Clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool DeformationEngine::IsCancelled(Input const & input)
+	{
+		return IsCancelRequested(input.cancelRequested);
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DeformationEngine::ReportProgress(Input const & input, float const progress)
+	{
+		if (input.progress != nullptr)
+		{
+			input.progress->store(progress, std::memory_order_relaxed);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DeformationEngine::ProjectCurtainPoints(Input const & input, Parameters const & parameters, Result & outResult)
+	{
+		std::vector<glm::vec3> allSampledPoints{};
+		std::vector<glm::vec3> allSampledNormals{};
+
+		Curve::UniformSample(
+			input.strokePoints,
+			input.projectionDirections,
+			allSampledPoints,
+			allSampledNormals,
+			parameters.deltaS
+		);
+
+		if (IsCancelled(input) == true)
+		{
+			return;
+		}
+
+		auto const sampleCount = static_cast<int>(allSampledPoints.size());
+		std::vector<glm::dvec3> origins(sampleCount);
+		std::vector<glm::dvec3> directions(sampleCount);
+		for (int i = 0; i < sampleCount; ++i)
+		{
+			origins[i] = allSampledPoints[i];
+			directions[i] = allSampledNormals[i];
+		}
+
+		std::vector<MFA::Collision::RayHit> hits(sampleCount);
+		if (input.collisionBVH != nullptr)
+		{
+			MFA::Collision::RaycastBatch(
+				*input.collisionBVH,
+				*input.collisionMesh,
+				origins,
+				directions,
+				1000.0,
+				false,
+				hits
+			);
+		}
+		else
+		{
+			MFA::Collision::RaycastBatch(*input.collisionMesh, origins, directions, 1000.0, false, hits);
+		}
+
+		for (int i = 0; i < sampleCount; ++i)
+		{
+			auto const & hit = hits[i];
+			if (hit.hasCollision == true)
+			{
+				outResult.projectedPoints.emplace_back(hit.position);
+				outResult.projectedNormals.emplace_back(hit.normal);
+				outResult.projectedTriangles.emplace_back(hit.triangleIdx);
+
+				outResult.sampledPoints.emplace_back(allSampledPoints[i]);
+				outResult.sampledNormals.emplace_back(allSampledNormals[i]);
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DeformationEngine::AggregateConstraints(Parameters const & parameters, Result const & result, System & outSystem)
+	{
+		auto const sampleCount = static_cast<int>(result.projectedPoints.size());
+		auto & constraints = outSystem.constraints;
+		constraints.clear();
+
+		if (parameters.constraintMergeDistance <= 0.0f)
+		{
+			constraints.reserve(sampleCount);
+			for (int sIdx = 0; sIdx < sampleCount; ++sIdx)
+			{
+				constraints.emplace_back(Constraint{
+					.triangle = result.projectedTriangles[sIdx],
+					.position = result.projectedPoints[sIdx],
+					.displacement = glm::dvec3{result.sampledPoints[sIdx]} - result.projectedPoints[sIdx],
+					.weight = 1.0
+				});
+			}
+			return;
+		}
+
+		// Samples are grouped by their triangle and a grid cell of the merge distance. Barycentric coordinates are
+		// linear inside a triangle, so the k rows of a group sum to k |b_mean x - d_mean|^2 plus the spread
+		// sum_i |(b_i - b_mean) x - (d_i - d_mean)|^2. The merged row keeps the first term and drops the spread,
+		// which is only an approximation of the fit. It stays small while the cell is small next to the triangle.
+		double const cellSize = parameters.constraintMergeDistance;
+		std::map<std::tuple<int, int64_t, int64_t, int64_t>, int> cellToConstraint{};
+		for (int sIdx = 0; sIdx < sampleCount; ++sIdx)
+		{
+			auto const & position = result.projectedPoints[sIdx];
+			auto const key = std::tuple{
+				result.projectedTriangles[sIdx],
+				static_cast<int64_t>(std::floor(position.x / cellSize)),
+				static_cast<int64_t>(std::floor(position.y / cellSize)),
+				static_cast<int64_t>(std::floor(position.z / cellSize))
+			};
+			auto const displacement = glm::dvec3{result.sampledPoints[sIdx]} - position;
+
+			auto const [itr, inserted] = cellToConstraint.try_emplace(key, static_cast<int>(constraints.size()));
+			if (inserted == true)
+			{
+				constraints.emplace_back(Constraint{
+					.triangle = result.projectedTriangles[sIdx],
+					.position = position,
+					.displacement = displacement,
+					.weight = 1.0
+				});
+			}
+			else
+			{
+				auto & constraint = constraints[itr->second];
+				constraint.position += position;
+				constraint.displacement += displacement;
+				constraint.weight += 1.0;
+			}
+		}
+
+		for (auto & constraint : constraints)
+		{
+			constraint.position /= constraint.weight;
+			constraint.displacement /= constraint.weight;
+		}
+
+		MFA_LOG_INFO("Merged %d samples into %d constraints", sampleCount, static_cast<int>(constraints.size()));
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DeformationEngine::CalcVertexToPointContribution(
+		Input const & input,
+		Parameters const & parameters,
+		System & inOutSystem
+	)
+	{
+		int const fineLvl = static_cast<int>(input.levels.size()) - 1;
+		auto const & constraints = inOutSystem.constraints;
+		auto const pointCount = static_cast<int>(constraints.size());
+
+		std::vector<Eigen::Triplet<float>> pointToVertex{};
+
+		std::unordered_map<int, int> vGtoLIdx{}; // Vertex global to local idx
+		std::vector<int> lToGIdx{};
+
+		auto FindOrInsertVertex = [&](int globalIdx)->int
+		{
+			auto const findResult = vGtoLIdx.find(globalIdx);
+			if (findResult != vGtoLIdx.end())
+			{
+				return findResult->second;
+			}
+
+			int const localIdx = static_cast<int>(lToGIdx.size());
+			vGtoLIdx[globalIdx] = localIdx;
+			lToGIdx.emplace_back(globalIdx);
+
+			return localIdx;
+		};
+
+		for (int pIdx = 0; pIdx < pointCount; ++pIdx)
+		{
+			auto const & constraint = constraints[pIdx];
+			int const triangleIdx = constraint.triangle;
+
+			auto const & collisionMesh = *input.collisionMesh;
+			MFA_ASSERT(triangleIdx >= 0 && triangleIdx < static_cast<int>(collisionMesh.triangles.size()));
+			auto const & [idx0, idx1, idx2] = collisionMesh.triangles[triangleIdx];
+
+			auto const & v0 = collisionMesh.positions[idx0];
+			auto const & v1 = collisionMesh.positions[idx1];
+			auto const & v2 = collisionMesh.positions[idx2];
+
+			auto const coordinate = MFA::Math::CalcBarycentricCoordinate(
+				constraint.position,
+				v0,
+				v1,
+				v2
+			);
+
+			// A merged constraint stands for all of its samples in the least squares sum
+			auto const rowScale = static_cast<float>(std::sqrt(constraint.weight));
+			pointToVertex.emplace_back(pIdx, idx0, coordinate.x * rowScale);
+			pointToVertex.emplace_back(pIdx, idx1, coordinate.y * rowScale);
+			pointToVertex.emplace_back(pIdx, idx2, coordinate.z * rowScale);
+		}
+
+		auto const fineVertexCount = static_cast<int>(input.levels[fineLvl].mesh->nVertices());
+		StencilOperatorCache::SparseMatrix pointToFine(pointCount, fineVertexCount);
+		pointToFine.setFromTriplets(pointToVertex.begin(), pointToVertex.end());
+
+		// Mapping the points back several levels is a single product with the cached composite operator
+		StencilOperatorCache::SparseMatrix pointToCoarse{};
+		if (parameters.numberOfEffectLevels > 0)
+		{
+			auto const & fineToCoarse = _stencilOperatorCache.GetOperator(
+				*input.contributionMaps,
+				fineLvl,
+				parameters.numberOfEffectLevels
+			);
+			pointToCoarse = pointToFine * fineToCoarse;
+		}
+		else
+		{
+			pointToCoarse = std::move(pointToFine);
+		}
+
+		for (int pIdx = 0; pIdx < pointToCoarse.outerSize(); ++pIdx)
+		{
+			for (StencilOperatorCache::SparseMatrix::InnerIterator itr(pointToCoarse, pIdx); itr; ++itr)
+			{
+				inOutSystem.vToPContrib.emplace_back(std::tuple{ FindOrInsertVertex(static_cast<int>(itr.col())), pIdx, itr.value() });
+			}
+		}
+
+		auto const & positions = input.levels[fineLvl - parameters.numberOfEffectLevels].geometry->vertexPositions;
+		inOutSystem.vertexGIndices = lToGIdx;
+		for (auto gIdx : lToGIdx)
+		{
+			auto const & position = positions[gIdx];
+			inOutSystem.movableVertices.emplace_back(position.x, position.y, position.z);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DeformationEngine::CalcLaplacianContribution(
+		Level const & level,
+		Parameters const & parameters,
+		std::unordered_map<int, geometrycentral::Vector3> const & movedPositions,
+		System & inOutSystem
+	)
+	{
+		auto & movableVertices = inOutSystem.movableVertices;
+		auto & vertexGIndices = inOutSystem.vertexGIndices;
+		auto & allVertices = inOutSystem.allVertices;
+		auto & vToVContrib = inOutSystem.vToVContrib;
+		auto & localIdxToLaplacian = inOutSystem.localIdxToLaplacian;
+
+		// All vertices must contain movable vertices as well
+		allVertices = movableVertices;
+		localIdxToLaplacian.resize(allVertices.size());
+
+		std::unordered_map<int, int> gToLVMap{};												// Global to local vertex map
+		for (int lIdx = 0; lIdx < static_cast<int>(vertexGIndices.size()); ++lIdx)
+		{
+			auto wIdx = vertexGIndices[lIdx];
+			MFA_ASSERT(gToLVMap.contains(wIdx) == false);
+			gToLVMap[wIdx] = lIdx;
+		}
+
+		auto const & positions = level.geometry->vertexPositions;
+
+		auto const ReadPosition = [&](int const vIdx)->glm::vec3
+		{
+			auto const findResult = movedPositions.find(vIdx);
+			auto const & position = findResult != movedPositions.end() ? findResult->second : positions[vIdx];
+			return glm::vec3{ position.x, position.y, position.z };
+		};
+
+		std::vector<int> queryIndices = vertexGIndices;
+		for (int itrCount = 0; itrCount < parameters.laplacianDistance; ++itrCount)
+		{
+			std::vector<int> nextQueryIndices{};
+			for (auto myGIdx : queryIndices)
+			{
+				MFA_ASSERT(gToLVMap.contains(myGIdx));
+				auto myLIdx = gToLVMap[myGIdx];
+
+				std::set<int> allVertexNeighbors{};
+				GetVertexNeighbors(*level.mesh, myGIdx, allVertexNeighbors);
+
+				glm::vec3 laplacian = allVertices[myLIdx];
+				bool isMovable = itrCount < parameters.laplacianDistance - 1;
+				bool canInsert = itrCount < parameters.laplacianDistance;
+
+				std::vector<int> validNeighbors{};
+				for (auto & neighGIdx : allVertexNeighbors)
+				{
+					auto const findLIdResult = gToLVMap.find(neighGIdx);
+					if (findLIdResult == gToLVMap.end())
+					{
+						if (canInsert == true)
+						{
+							glm::vec3 const position = ReadPosition(neighGIdx);
+
+							auto const neighLIdx = static_cast<int>(allVertices.size());
+							if (isMovable == true)
+							{
+								movableVertices.emplace_back(position);
+							}
+							allVertices.emplace_back(position);
+							localIdxToLaplacian.emplace_back();
+							vertexGIndices.emplace_back(neighGIdx);
+							nextQueryIndices.emplace_back(neighGIdx);
+							gToLVMap[neighGIdx] = neighLIdx;
+
+							validNeighbors.emplace_back(neighGIdx);
+						}
+					}
+					else
+					{
+						validNeighbors.emplace_back(neighGIdx);
+					}
+				}
+
+				float weight = 1.0f / static_cast<float>(validNeighbors.size());
+
+				for (auto & neighGIdx : validNeighbors)
+				{
+					auto const findLIdResult = gToLVMap.find(neighGIdx);
+
+					if (findLIdResult != gToLVMap.end())
+					{
+						auto const neighLIdx = findLIdResult->second;
+						laplacian -= weight * allVertices[neighLIdx];
+						vToVContrib.emplace_back(std::tuple{ neighLIdx, myLIdx, -weight });
+					}
+				}
+
+				vToVContrib.emplace_back(std::tuple{ myLIdx, myLIdx, 1.0f });
+
+				localIdxToLaplacian[myLIdx] = laplacian;
+			}
+			queryIndices = nextQueryIndices;
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DeformationEngine::GetVertexNeighbors(Mesh & mesh, int const vertexIdx, std::set<int> & outVIds)
+	{
+		outVIds.clear();
+		Vertex const vertex = mesh.vertex(vertexIdx);
+		for (Halfedge const he : vertex.outgoingHalfedges())
+		{
+			outVIds.emplace(static_cast<int>(he.twin().vertex().getIndex()));
+
+			Face const face = he.face();
+			if (face.degree() != 4)
+			{
+				MFA_ASSERT(face.degree() == 3);
+				continue;
+			}
+			Halfedge const first = face.halfedge();
+			Halfedge const third = first.next().next();
+			if (first.vertex() == vertex)
+			{
+				outVIds.emplace(static_cast<int>(third.vertex().getIndex()));
+			}
+			else if (third.vertex() == vertex)
+			{
+				outVIds.emplace(static_cast<int>(first.vertex().getIndex()));
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool DeformationEngine::Solve(
+		Input const & input,
+		Parameters const & parameters,
+		System const & system,
+		int const level,
+		Eigen::MatrixX3d & outDisplacements
+	)
+	{
+		//https://eigen.tuxfamily.org/dox-devel/group__LeastSquares.html
+		// Both terms are assembled sparse and the normal equations are solved in double precision because
+		// Y^T * Y is a bi-laplacian whose condition number grows quickly with the region size.
+		using SparseMatrix = SparseSolveMatrix;
+		auto const pointCount = static_cast<int>(system.constraints.size());
+		auto const movableCount = static_cast<int>(system.movableVertices.size());
+		auto const allCount = static_cast<int>(system.allVertices.size());
+		double const laplacianWeight = parameters.laplacianWeight;
+
+		std::vector<Eigen::Triplet<double>> triplets{};
+		triplets.reserve(system.vToPContrib.size());
+		for (auto & [vIdx, pIdx, value] : system.vToPContrib)
+		{
+			MFA_ASSERT(pointCount > pIdx);
+			MFA_ASSERT(movableCount > vIdx);
+			triplets.emplace_back(pIdx, vIdx, value);
+		}
+		SparseMatrix B(pointCount, movableCount);
+		B.setFromTriplets(triplets.begin(), triplets.end());
+
+		// x, y and z share the same matrix so they are solved as one right hand side with three columns
+		Eigen::MatrixX3d b(pointCount, 3);
+		for (int i = 0; i < pointCount; ++i)
+		{
+			auto const & constraint = system.constraints[i];
+			auto const target = constraint.displacement * std::sqrt(constraint.weight);
+			b(i, 0) = target.x;
+			b(i, 1) = target.y;
+			b(i, 2) = target.z;
+		}
+
+		if (parameters.model == DeformationModel::AsRigidAsPossible)
+		{
+			return SolveAsRigidAsPossible(input, parameters, system, level, B, b, outDisplacements);
+		}
+
+		// Only the movable vertices are unknowns, the remaining columns belong to the fixed ring
+		triplets.clear();
+		triplets.reserve(system.vToVContrib.size());
+		for (auto & [nIdx, myIdx, value] : system.vToVContrib)
+		{
+			if (allCount > myIdx && movableCount > nIdx)
+			{
+				triplets.emplace_back(myIdx, nIdx, value);
+			}
+		}
+		SparseMatrix Y(allCount, movableCount);
+		Y.setFromTriplets(triplets.begin(), triplets.end());
+
+		Eigen::MatrixX3d y(allCount, 3);
+		for (int localIdx = 0; localIdx < allCount; ++localIdx)
+		{
+			auto const & laplacian = system.localIdxToLaplacian[localIdx];
+			y(localIdx, 0) = -laplacian.x;
+			y(localIdx, 1) = -laplacian.y;
+			y(localIdx, 2) = -laplacian.z;
+		}
+
+		Eigen::MatrixX3d const rhs = (B.transpose() * b) * (1.0 - laplacianWeight) + (Y.transpose() * y) * laplacianWeight;
+
+		// Movable vertices are always the first entries of vertexGIndices
+		std::vector<int> const movableGIndices(
+			system.vertexGIndices.begin(),
+			system.vertexGIndices.begin() + movableCount
+		);
+
+		auto blocks = SplitIndependentBlocks(B, Y, rhs, movableGIndices);
+		if (blocks.empty() == false)
+		{
+			bool const factored = SolveBlocks(input, parameters, level, blocks);
+
+			outDisplacements.resize(movableCount, 3);
+			for (auto const & block : blocks)
+			{
+				for (int i = 0; i < static_cast<int>(block.unknowns.size()); ++i)
+				{
+					outDisplacements.row(block.unknowns[i]) = block.x.row(i);
+				}
+			}
+			return factored;
+		}
+
+		bool factored = true;
+		switch (parameters.solver)
+		{
+		case SolverType::Multigrid:
+		{
+			MultigridSolver const solver(
+				std::move(B),
+				std::move(Y),
+				laplacianWeight,
+				*input.contributionMaps,
+				level,
+				movableGIndices,
+				MultigridSolver::Options{}
+			);
+			solver.Solve(rhs, outDisplacements, input.cancelRequested);
+			factored = solver.IsFactored();
+			MFA_LOG_INFO(
+				"Multigrid solve: %d unknowns, %d grids, %d iterations",
+				movableCount,
+				solver.GetGridCount(),
+				solver.GetLastIterationCount()
+			);
+		}
+		break;
+		case SolverType::Direct:
+		{
+			// Redrawing over the same region reuses the factorization of the previous stroke
+			factored = _factorizationCache.Solve(
+				level,
+				laplacianWeight,
+				movableGIndices,
+				B,
+				Y,
+				rhs,
+				outDisplacements,
+				input.cancelRequested
+			);
+			MFA_LOG_INFO(
+				"Direct solve: %d unknowns, cached factorization %d, %d iterations",
+				movableCount,
+				_factorizationCache.WasLastSolveCached(),
+				_factorizationCache.GetLastIterationCount()
+			);
+		}
+		break;
+		}
+		return factored;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool DeformationEngine::SolveAsRigidAsPossible(
+		Input const & input,
+		Parameters const & parameters,
+		System const & system,
+		int const level,
+		SparseSolveMatrix const & B,
+		Eigen::MatrixX3d const & b,
+		Eigen::MatrixX3d & outDisplacements
+	)
+	{
+		double const laplacianWeight = parameters.laplacianWeight;
+		auto const movableCount = static_cast<int>(system.movableVertices.size());
+		auto const allCount = static_cast<int>(system.allVertices.size());
+
+		std::vector<glm::dvec3> restPositions(allCount);
+		for (int localIdx = 0; localIdx < allCount; ++localIdx)
+		{
+			restPositions[localIdx] = system.allVertices[localIdx];
+		}
+
+		// Stars are the same neighbourhoods that the laplacian rows use
+		std::vector<std::vector<int>> neighbours(allCount);
+		for (auto const & [nIdx, myIdx, value] : system.vToVContrib)
+		{
+			if (nIdx != myIdx)
+			{
+				neighbours[myIdx].emplace_back(nIdx);
+			}
+		}
+
+		ArapSolver const solver(
+			B,
+			laplacianWeight,
+			restPositions,
+			neighbours,
+			movableCount,
+			ArapSolver::Options{
+				.maxIterations = parameters.arapIterations
+			}
+		);
+		auto const & E = solver.GetEdgeMatrix();
+
+		std::vector<int> const movableGIndices(
+			system.vertexGIndices.begin(),
+			system.vertexGIndices.begin() + movableCount
+		);
+
+		// The coupling of the global step does not change between the iterations, only its right hand side
+		auto blocks = SplitIndependentBlocks(B, E, Eigen::MatrixX3d::Zero(movableCount, 3), movableGIndices);
+
+		int globalSolveCount = 0;
+		int cachedSolveCount = 0;
+		auto const GlobalSolve = [&](Eigen::MatrixX3d const & rhs, Eigen::MatrixX3d & inOutX)->bool
+		{
+			bool factored = false;
+			if (blocks.empty() == true)
+			{
+				factored = _arapFactorizationCache.Solve(
+					level,
+					laplacianWeight,
+					movableGIndices,
+					B,
+					E,
+					rhs,
+					inOutX,
+					input.cancelRequested
+				);
+			}
+			else
+			{
+				std::vector<FactorizationCache::Block> cacheBlocks{};
+				cacheBlocks.reserve(blocks.size());
+				for (auto & block : blocks)
+				{
+					for (int i = 0; i < static_cast<int>(block.unknowns.size()); ++i)
+					{
+						block.rhs.row(i) = rhs.row(block.unknowns[i]);
+					}
+					cacheBlocks.emplace_back(FactorizationCache::Block{
+						.vertexIndices = &block.vertexIndices,
+						.B = &block.B,
+						.Y = &block.Y,
+						.rhs = &block.rhs,
+						.outX = &block.x
+					});
+				}
+				factored = _arapFactorizationCache.Solve(level, laplacianWeight, cacheBlocks, input.cancelRequested);
+
+				inOutX.resize(movableCount, 3);
+				for (auto const & block : blocks)
+				{
+					for (int i = 0; i < static_cast<int>(block.unknowns.size()); ++i)
+					{
+						inOutX.row(block.unknowns[i]) = block.x.row(i);
+					}
+				}
+			}
+			++globalSolveCount;
+			cachedSolveCount += _arapFactorizationCache.WasLastSolveCached() == true ? 1 : 0;
+			return factored;
+		};
+
+		bool const factored = solver.Solve(b, GlobalSolve, outDisplacements, input.cancelRequested);
+		MFA_LOG_INFO(
+			"ARAP solve: %d unknowns in %d independent blocks, %d iterations, %d of %d global steps cached",
+			movableCount,
+			std::max(static_cast<int>(blocks.size()), 1),
+			solver.GetLastIterationCount(),
+			cachedSolveCount,
+			globalSolveCount
+		);
+		return factored;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	std::vector<DeformationEngine::SystemBlock> DeformationEngine::SplitIndependentBlocks(
+		SparseSolveMatrix const & B,
+		SparseSolveMatrix const & Y,
+		Eigen::MatrixX3d const & rhs,
+		std::vector<int> const & vertexIndices
+	)
+	{
+		auto const unknownCount = static_cast<int>(B.cols());
+		MFA_ASSERT(Y.cols() == unknownCount);
+		MFA_ASSERT(static_cast<int>(vertexIndices.size()) == unknownCount);
+
+		// Union-find over the unknowns, every row of B and Y couples all of its columns
+		std::vector<int> parent(unknownCount);
+		std::iota(parent.begin(), parent.end(), 0);
+		auto const FindRoot = [&parent](int idx)->int
+		{
+			while (parent[idx] != idx)
+			{
+				parent[idx] = parent[parent[idx]];
+				idx = parent[idx];
+			}
+			return idx;
+		};
+
+		auto const UniteRows = [&](SparseSolveMatrix const & matrix)->void
+		{
+			std::vector<int> rowFirstColumn(matrix.rows(), -1);
+			for (int col = 0; col < matrix.outerSize(); ++col)
+			{
+				for (SparseSolveMatrix::InnerIterator itr(matrix, col); itr; ++itr)
+				{
+					auto & firstColumn = rowFirstColumn[itr.row()];
+					if (firstColumn < 0)
+					{
+						firstColumn = col;
+						continue;
+					}
+					auto const rootA = FindRoot(firstColumn);
+					auto const rootB = FindRoot(col);
+					if (rootA != rootB)
+					{
+						parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+					}
+				}
+			}
+		};
+		UniteRows(B);
+		UniteRows(Y);
+
+		std::vector<int> blockOf(unknownCount);
+		std::vector<int> localIdx(unknownCount);
+		std::vector<int> rootToBlock(unknownCount, -1);
+		std::vector<SystemBlock> blocks{};
+		for (int idx = 0; idx < unknownCount; ++idx)
+		{
+			auto & blockIdx = rootToBlock[FindRoot(idx)];
+			if (blockIdx < 0)
+			{
+				blockIdx = static_cast<int>(blocks.size());
+				blocks.emplace_back();
+			}
+			auto & block = blocks[blockIdx];
+			blockOf[idx] = blockIdx;
+			localIdx[idx] = static_cast<int>(block.unknowns.size());
+			block.unknowns.emplace_back(idx);
+			block.vertexIndices.emplace_back(vertexIndices[idx]);
+		}
+
+		if (blocks.size() < 2)
+		{
+			return {};
+		}
+
+		// Rows never span two blocks, so each row is renumbered inside the block of its columns
+		auto const SplitRows = [&](SparseSolveMatrix const & matrix, SparseSolveMatrix SystemBlock::* member)->void
+		{
+			std::vector<int> rowLocalIdx(matrix.rows(), -1);
+			std::vector<int> rowCounts(blocks.size(), 0);
+			std::vector<std::vector<Eigen::Triplet<double>>> triplets(blocks.size());
+			for (int col = 0; col < matrix.outerSize(); ++col)
+			{
+				auto const blockIdx = blockOf[col];
+				for (SparseSolveMatrix::InnerIterator itr(matrix, col); itr; ++itr)
+				{
+					auto & localRow = rowLocalIdx[itr.row()];
+					if (localRow < 0)
+					{
+						localRow = rowCounts[blockIdx]++;
+					}
+					triplets[blockIdx].emplace_back(localRow, localIdx[col], itr.value());
+				}
+			}
+			for (int blockIdx = 0; blockIdx < static_cast<int>(blocks.size()); ++blockIdx)
+			{
+				auto & blockMatrix = blocks[blockIdx].*member;
+				blockMatrix.resize(rowCounts[blockIdx], static_cast<int>(blocks[blockIdx].unknowns.size()));
+				blockMatrix.setFromTriplets(triplets[blockIdx].begin(), triplets[blockIdx].end());
+			}
+		};
+		SplitRows(B, &SystemBlock::B);
+		SplitRows(Y, &SystemBlock::Y);
+
+		for (auto & block : blocks)
+		{
+			auto const blockUnknownCount = static_cast<int>(block.unknowns.size());
+			block.rhs.resize(blockUnknownCount, 3);
+			for (int i = 0; i < blockUnknownCount; ++i)
+			{
+				block.rhs.row(i) = rhs.row(block.unknowns[i]);
+			}
+			block.x = Eigen::MatrixX3d::Zero(blockUnknownCount, 3);
+		}
+
+		return blocks;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool DeformationEngine::SolveBlocks(
+		Input const & input,
+		Parameters const & parameters,
+		int const level,
+		std::vector<SystemBlock> & blocks
+	)
+	{
+		double const laplacianWeight = parameters.laplacianWeight;
+		auto const blockCount = static_cast<int>(blocks.size());
+
+		int unknownCount = 0;
+		for (auto const & block : blocks)
+		{
+			unknownCount += static_cast<int>(block.unknowns.size());
+		}
+
+		bool factored = true;
+		switch (parameters.solver)
+		{
+		case SolverType::Multigrid:
+		{
+			int maxIterationCount = 0;
+			#pragma omp parallel for schedule(dynamic) reduction(max: maxIterationCount) reduction(&&: factored)
+			for (int blockIdx = 0; blockIdx < blockCount; ++blockIdx)
+			{
+				auto & block = blocks[blockIdx];
+				MultigridSolver const solver(
+					std::move(block.B),
+					std::move(block.Y),
+					laplacianWeight,
+					*input.contributionMaps,
+					level,
+					block.vertexIndices,
+					MultigridSolver::Options{}
+				);
+				solver.Solve(block.rhs, block.x, input.cancelRequested);
+				factored = factored && solver.IsFactored();
+				maxIterationCount = std::max(maxIterationCount, solver.GetLastIterationCount());
+			}
+			MFA_LOG_INFO(
+				"Multigrid solve: %d unknowns in %d independent blocks, at most %d iterations",
+				unknownCount,
+				blockCount,
+				maxIterationCount
+			);
+		}
+		break;
+		case SolverType::Direct:
+		{
+			std::vector<FactorizationCache::Block> cacheBlocks{};
+			cacheBlocks.reserve(blocks.size());
+			for (auto & block : blocks)
+			{
+				cacheBlocks.emplace_back(FactorizationCache::Block{
+					.vertexIndices = &block.vertexIndices,
+					.B = &block.B,
+					.Y = &block.Y,
+					.rhs = &block.rhs,
+					.outX = &block.x
+				});
+			}
+			factored = _factorizationCache.Solve(level, laplacianWeight, cacheBlocks, input.cancelRequested);
+			MFA_LOG_INFO(
+				"Direct solve: %d unknowns in %d independent blocks, cached factorizations %d, at most %d iterations",
+				unknownCount,
+				blockCount,
+				_factorizationCache.WasLastSolveCached(),
+				_factorizationCache.GetLastIterationCount()
+			);
+		}
+		break;
+		}
+		return factored;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "Collision.hpp"
+#include "Contribution.hpp"
+#include "FactorizationCache.hpp"
+#include "StencilOperatorCache.hpp"
+#include "TriangleBVH.hpp"
+
+#include "geometrycentral/surface/manifold_surface_mesh.h"
+#include "geometrycentral/surface/vertex_position_geometry.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace shared
+{
+    // Curtain based deformation of a subdivision hierarchy without any render or UI dependency.
+    // A stroke drawn on the curtain is sampled, projected onto the surface along the curtain normals and the surface
+    // is moved towards the samples by a laplacian regularized least squares fit. The fit can be solved at a coarser
+    // level than the one the stroke is drawn on, the result is returned as displacements for every level in between.
+    // The engine only reads the hierarchy, applying the displacements is up to the caller.
+    class DeformationEngine
+    {
+    public:
+
+        using Mesh = geometrycentral::surface::ManifoldSurfaceMesh;
+        using Geometry = geometrycentral::surface::VertexPositionGeometry;
+        using CollisionMesh = MFA::CollisionMesh;
+        using ContributionMapList = std::vector<std::shared_ptr<ContributionMap>>;
+
+        enum class SolverType
+        {
+            Direct,         // Sparse LDLT, factorizations of a region are reused by later strokes
+            Multigrid       // Conjugate gradient preconditioned by the coarser levels
+        };
+
+        enum class DeformationModel
+        {
+            Laplacian,          // Linear least squares with a laplacian regularizer
+            AsRigidAsPossible   // Rotations of the vertex stars are fitted iteratively, always solved directly
+        };
+
+        struct Parameters
+        {
+            float deltaS = 0.001f;              // Sampling distance along the stroke
+            int laplacianDistance = 5;          // Rings around the projected points that are part of the fit
+            float laplacianWeight = 0.9f;
+            int numberOfEffectLevels = 0;       // The fit is solved this many levels below the drawn level
+            SolverType solver = SolverType::Direct;
+            // Samples on the same triangle that are closer than this are merged into one weighted constraint, which
+            // approximates their rows by their mean. Small sampling distances give many near duplicate rows,
+            // 0 keeps one constraint per sample and the exact fit.
+            float constraintMergeDistance = 0.0f;
+            DeformationModel model = DeformationModel::Laplacian;
+            int arapIterations = 5;             // Local/global iterations after the initial solve
+            // The preview is solved this many levels below the solved level, 0 disables it
+            int previewLevels = 0;
+        };
+
+        struct Level
+        {
+            Mesh * mesh = nullptr;
+            Geometry const * geometry = nullptr;
+        };
+
+        struct Result;
+
+        struct Input
+        {
+            std::vector<Level> levels{};                                        // Level 0 up to the drawn level
+            ContributionMapList const * contributionMaps = nullptr;             // Element i maps level i to level i + 1
+            // Collision mesh of the drawn level, its positions and triangles use the vertex indices of that level
+            CollisionMesh const * collisionMesh = nullptr;
+            MFA::CollisionBVH const * collisionBVH = nullptr;                  // Optional, built over collisionMesh
+            std::vector<glm::vec3> strokePoints{};                              // Points drawn on the curtain
+            std::vector<glm::vec3> projectionDirections{};                      // Curtain normal of every stroke point
+            // Optional, for running the engine on a worker thread. Cancellation is checked between the stages and
+            // in every iteration of the iterative solvers, only a sparse factorization runs to its end once started.
+            std::atomic<bool> const * cancelRequested = nullptr;
+            std::atomic<float> * progress = nullptr;                           // From 0 to 1
+            // Receives a coarse approximation before the exact system is assembled, it runs on the thread of Deform.
+            // Once it is called the engine does not read the collision mesh or the positions that the preview moves
+            // anymore, so the preview can be applied while the exact fit is still running.
+            std::function<void(Result const & preview)> onPreview{};
+        };
+
+        struct LevelDisplacement
+        {
+            int level = -1;
+            std::vector<int> vertexIndices{};
+            std::vector<geometrycentral::Vector3> deltas{};
+        };
+
+        struct Result
+        {
+            // Samples that hit the surface and where they hit it
+            std::vector<glm::vec3> sampledPoints{};
+            std::vector<glm::vec3> sampledNormals{};
+            std::vector<glm::dvec3> projectedPoints{};
+            std::vector<glm::dvec3> projectedNormals{};
+            std::vector<int> projectedTriangles{};
+
+            // Solved level first, then every finer level up to the drawn one
+            std::vector<LevelDisplacement> displacements{};
+        };
+
+        explicit DeformationEngine();
+
+        // Returns false if no sample reached the surface, the fit could not be factored or the call was cancelled.
+        // The result is empty in that case.
+        // Only reads the input, but a single engine must not be used by two threads at the same time.
+        bool Deform(Input const & input, Parameters const & parameters, Result & outResult);
+
+        // Has to be called when the topology or the stencils of the hierarchy change
+        void ClearCaches();
+
+    private:
+
+        [[nodiscard]]
+        static bool IsCancelled(Input const & input);
+
+        static void ReportProgress(Input const & input, float progress);
+
+        // Pulls the surface at a point of a fine level triangle towards its sample
+        struct Constraint
+        {
+            int triangle = -1;
+            glm::dvec3 position{};                                              // On the triangle
+            glm::dvec3 displacement{};
+            double weight = 1.0;                                                // Number of merged samples
+        };
+
+        // Equations of the fit. Unknowns are the movable vertices, they are the first entries of vertexGIndices.
+        struct System
+        {
+            std::vector<Constraint> constraints{};
+            std::vector<glm::vec3> movableVertices{};
+            std::vector<int> vertexGIndices{};
+            std::vector<glm::vec3> allVertices{};                               // Movable vertices and the fixed ring
+            std::vector<std::tuple<int, int, float>> vToPContrib{};
+            std::vector<std::tuple<int, int, float>> vToVContrib{};
+            std::vector<glm::vec3> localIdxToLaplacian{};
+        };
+
+        static void ProjectCurtainPoints(Input const & input, Parameters const & parameters, Result & outResult);
+
+        static void AggregateConstraints(Parameters const & parameters, Result const & result, System & outSystem);
+
+        void CalcVertexToPointContribution(Input const & input, Parameters const & parameters, System & inOutSystem);
+
+        // movedPositions: positions of the level from before the preview was handed out, they are read instead of
+        // the geometry because the caller may be applying the preview concurrently
+        static void CalcLaplacianContribution(
+            Level const & level,
+            Parameters const & parameters,
+            std::unordered_map<int, geometrycentral::Vector3> const & movedPositions,
+            System & inOutSystem
+        );
+
+        // Neighbours in the triangulation of the level, quads are split along their corner 0 - corner 2 diagonal
+        static void GetVertexNeighbors(Mesh & mesh, int vertexIdx, std::set<int> & outVIds);
+
+        // Returns false if the system could not be factored, the displacements are zero in that case
+        [[nodiscard]]
+        bool Solve(
+            Input const & input,
+            Parameters const & parameters,
+            System const & system,
+            int level,
+            Eigen::MatrixX3d & outDisplacements
+        );
+
+        // Displacements of the solved level followed by the ones of every finer level up to the drawn one
+        static void PropagateDisplacements(
+            Input const & input,
+            System const & system,
+            int level,
+            Eigen::MatrixX3d const & displacements,
+            std::vector<LevelDisplacement> & outDisplacements
+        );
+
+        // The global steps go through the independent blocks and the ARAP factorization cache, so a stroke over a
+        // region that was solved before starts from the factor of that region instead of refactoring
+        [[nodiscard]]
+        bool SolveAsRigidAsPossible(
+            Input const & input,
+            Parameters const & parameters,
+            System const & system,
+            int level,
+            SparseSolveMatrix const & B,
+            Eigen::MatrixX3d const & b,
+            Eigen::MatrixX3d & outDisplacements
+        );
+
+        // Unknowns that share no equation with the rest, strokes over separated parts of the surface give one
+        // block per part and each of them is an independent system
+        struct SystemBlock
+        {
+            std::vector<int> unknowns{};                                        // Columns of the full system
+            std::vector<int> vertexIndices{};
+            SparseSolveMatrix B{};
+            SparseSolveMatrix Y{};
+            Eigen::MatrixX3d rhs{};
+            Eigen::MatrixX3d x{};
+        };
+
+        // Returns an empty list if all unknowns are coupled
+        [[nodiscard]]
+        static std::vector<SystemBlock> SplitIndependentBlocks(
+            SparseSolveMatrix const & B,
+            SparseSolveMatrix const & Y,
+            Eigen::MatrixX3d const & rhs,
+            std::vector<int> const & vertexIndices
+        );
+
+        // Blocks are solved concurrently, returns false if any of them could not be factored
+        [[nodiscard]]
+        bool SolveBlocks(
+            Input const & input,
+            Parameters const & parameters,
+            int level,
+            std::vector<SystemBlock> & blocks
+        );
+
+        StencilOperatorCache _stencilOperatorCache{};
+        FactorizationCache _factorizationCache;
+        // Edge rows of the ARAP global step replace the laplacian rows, so its factors are kept apart
+        FactorizationCache _arapFactorizationCache;
+
+    };
+}
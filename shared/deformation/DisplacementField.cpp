@@ -0,0 +1,127 @@
+#include "DisplacementField.hpp"
+
+#include "BedrockAssert.hpp"
+
+#include <algorithm>
+
+namespace shared
+{
+
+	//-----------------------------------------------------------------------------------------
+
+	void DisplacementField::Record(std::vector<int> const & vertexIndices, std::vector<Vector3> const & deltas)
+	{
+		MFA_ASSERT(vertexIndices.size() == deltas.size());
+		_undoList.emplace_back(Edit{
+			.vertexIndices = vertexIndices,
+			.deltas = deltas
+		});
+		_redoList.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DisplacementField::MarkChanged(std::vector<int> const & vertexIndices, std::vector<Vector3> const & deltas)
+	{
+		MFA_ASSERT(vertexIndices.size() == deltas.size());
+		for (int i = 0; i < static_cast<int>(vertexIndices.size()); ++i)
+		{
+			auto const [itr, inserted] = _changes.try_emplace(vertexIndices[i], Vector3::zero());
+			itr->second += deltas[i];
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool DisplacementField::IsDirty() const
+	{
+		return _changes.empty() == false;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DisplacementField::TakeChanges(std::vector<int> & outVertexIndices, std::vector<Vector3> & outDeltas)
+	{
+		outVertexIndices.clear();
+		outDeltas.clear();
+
+		outVertexIndices.reserve(_changes.size());
+		for (auto const & [vIdx, delta] : _changes)
+		{
+			outVertexIndices.emplace_back(vIdx);
+		}
+		// Hash map order is not stable, sorting keeps the propagated result independent of it
+		std::sort(outVertexIndices.begin(), outVertexIndices.end());
+
+		outDeltas.reserve(outVertexIndices.size());
+		for (int const vIdx : outVertexIndices)
+		{
+			outDeltas.emplace_back(_changes.at(vIdx));
+		}
+
+		_changes.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DisplacementField::ClearChanges()
+	{
+		_changes.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool DisplacementField::Undo(std::vector<int> & outVertexIndices, std::vector<Vector3> & outDeltas)
+	{
+		if (_undoList.empty() == true)
+		{
+			return false;
+		}
+
+		auto & edit = _redoList.emplace_back(std::move(_undoList.back()));
+		_undoList.pop_back();
+
+		outVertexIndices = edit.vertexIndices;
+		outDeltas.resize(edit.deltas.size());
+		for (int i = 0; i < static_cast<int>(edit.deltas.size()); ++i)
+		{
+			outDeltas[i] = -edit.deltas[i];
+		}
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool DisplacementField::Redo(std::vector<int> & outVertexIndices, std::vector<Vector3> & outDeltas)
+	{
+		if (_redoList.empty() == true)
+		{
+			return false;
+		}
+
+		auto & edit = _undoList.emplace_back(std::move(_redoList.back()));
+		_redoList.pop_back();
+
+		outVertexIndices = edit.vertexIndices;
+		outDeltas = edit.deltas;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DisplacementField::ClearRedo()
+	{
+		_redoList.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void DisplacementField::DropOldestEdit()
+	{
+		MFA_ASSERT(_undoList.empty() == false);
+		_undoList.pop_front();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
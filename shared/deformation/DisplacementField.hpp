@@ -0,0 +1,63 @@
+#pragma once
+
+#include <geometrycentral/utilities/vector3.h>
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace shared
+{
+    // Changes of one subdivision level that the finer level has not received yet, merged per vertex so syncing only
+    // propagates the vertices that moved since the last sync no matter how many edits there were in between.
+    // Edits made at this level are kept as a history for undo and redo. The history is not bounded by the field,
+    // the caller drops the oldest edits once it holds as many as it wants to keep.
+    class DisplacementField
+    {
+    public:
+
+        using Vector3 = geometrycentral::Vector3;
+
+        // Edit made at this level, it is recorded in the history and clears the redo list
+        void Record(std::vector<int> const & vertexIndices, std::vector<Vector3> const & deltas);
+
+        // Positions of the level changed by the given amount, because of an edit or because a coarser level moved.
+        // Only the dirty set is updated.
+        void MarkChanged(std::vector<int> const & vertexIndices, std::vector<Vector3> const & deltas);
+
+        [[nodiscard]]
+        bool IsDirty() const;
+
+        // Moves the changes since the last call to the output, ordered by vertex idx
+        void TakeChanges(std::vector<int> & outVertexIndices, std::vector<Vector3> & outDeltas);
+
+        // Changes were already included by other means, e.g. the finer level was rebuilt from this one
+        void ClearChanges();
+
+        // Reverts the last recorded edit. Outputs the change that has to be applied to the positions of the level,
+        // it is not marked as changed. Returns false if there is nothing to undo.
+        bool Undo(std::vector<int> & outVertexIndices, std::vector<Vector3> & outDeltas);
+
+        // Returns false if there is nothing to redo
+        bool Redo(std::vector<int> & outVertexIndices, std::vector<Vector3> & outDeltas);
+
+        // Needed when an edit is made at another level, the edits that were undone here can not be redone after it
+        void ClearRedo();
+
+        // The oldest edit stays applied but can no longer be undone
+        void DropOldestEdit();
+
+    private:
+
+        struct Edit
+        {
+            std::vector<int> vertexIndices{};
+            std::vector<Vector3> deltas{};
+        };
+
+        std::unordered_map<int, Vector3> _changes{};
+        std::deque<Edit> _undoList{};
+        std::vector<Edit> _redoList{};
+
+    };
+}
@@ -0,0 +1,383 @@
+#include "FactorizationCache.hpp"
+
+#include "BedrockAssert.hpp"
+#include "BedrockLog.hpp"
+
+#include <algorithm>
+
+namespace shared
+{
+
+	//-----------------------------------------------------------------------------------------
+
+	namespace
+	{
+		size_t CalcRegionHash(std::vector<int> const & sortedIndices)
+		{
+			// FNV-1a over the vertex indices
+			uint64_t hash = 14695981039346656037ull;
+			for (int const idx : sortedIndices)
+			{
+				hash ^= static_cast<uint32_t>(idx);
+				hash *= 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	FactorizationCache::FactorizationCache(Options const & options)
+		: _options(options)
+	{
+		MFA_ASSERT(_options.capacity > 0);
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool FactorizationCache::Solve(
+		int const level,
+		double const laplacianWeight,
+		std::vector<int> const & vertexIndices,
+		SparseMatrix const & B,
+		SparseMatrix const & Y,
+		Eigen::MatrixX3d const & rhs,
+		Eigen::MatrixX3d & outX,
+		std::atomic<bool> const * cancelRequested
+	)
+	{
+		return Solve(level, laplacianWeight, std::vector<Block>{Block{
+			.vertexIndices = &vertexIndices,
+			.B = &B,
+			.Y = &Y,
+			.rhs = &rhs,
+			.outX = &outX
+		}}, cancelRequested);
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool FactorizationCache::Solve(
+		int const level,
+		double const laplacianWeight,
+		std::vector<Block> const & blocks,
+		std::atomic<bool> const * cancelRequested
+	)
+	{
+		auto const blockCount = static_cast<int>(blocks.size());
+
+		// Lookup and eviction are serial, the solves only touch their own entry
+		uint64_t const batchStart = _useCounter + 1;
+		std::vector<Entry *> entries(blockCount);
+		std::vector<bool> isFactored(blockCount);
+		for (int blockIdx = 0; blockIdx < blockCount; ++blockIdx)
+		{
+			auto const & block = blocks[blockIdx];
+			auto const unknownCount = static_cast<int>(block.vertexIndices->size());
+			MFA_ASSERT(block.B->cols() == unknownCount);
+			MFA_ASSERT(block.Y->cols() == unknownCount);
+			MFA_ASSERT(block.rhs->rows() == unknownCount);
+
+			std::vector<int> sortedIndices = *block.vertexIndices;
+			std::sort(sortedIndices.begin(), sortedIndices.end());
+			size_t const regionHash = CalcRegionHash(sortedIndices);
+
+			Entry * entry = Find(level, laplacianWeight, regionHash, sortedIndices);
+			isFactored[blockIdx] = entry != nullptr;
+			if (entry != nullptr)
+			{
+				entry->lastUse = ++_useCounter;
+			}
+			else
+			{
+				entry = &Insert(batchStart);
+				entry->level = level;
+				entry->laplacianWeight = laplacianWeight;
+				entry->regionHash = regionHash;
+				entry->sortedIndices = std::move(sortedIndices);
+			}
+			entries[blockIdx] = entry;
+		}
+
+		std::vector<BlockResult> results(blockCount);
+		#pragma omp parallel for schedule(dynamic) if (blockCount > 1)
+		for (int blockIdx = 0; blockIdx < blockCount; ++blockIdx)
+		{
+			results[blockIdx] = SolveBlock(
+				*entries[blockIdx],
+				isFactored[blockIdx],
+				laplacianWeight,
+				blocks[blockIdx],
+				cancelRequested
+			);
+		}
+
+		bool factored = true;
+		_lastSolveCached = true;
+		_lastIterationCount = 0;
+		for (auto const & result : results)
+		{
+			factored = factored && result.factored;
+			_lastSolveCached = _lastSolveCached && result.cached;
+			_lastIterationCount = std::max(_lastIterationCount, result.iterationCount);
+		}
+
+		Trim();
+
+		return factored;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	FactorizationCache::BlockResult FactorizationCache::SolveBlock(
+		Entry & entry,
+		bool const isFactored,
+		double const laplacianWeight,
+		Block const & block,
+		std::atomic<bool> const * cancelRequested
+	) const
+	{
+		auto const & vertexIndices = *block.vertexIndices;
+		auto const & B = *block.B;
+		auto const & Y = *block.Y;
+		auto const & rhs = *block.rhs;
+		auto & outX = *block.outX;
+		auto const unknownCount = static_cast<int>(vertexIndices.size());
+
+		BlockResult blockResult{};
+
+		if (isFactored == true)
+		{
+			std::vector<int> toFactorIdx(unknownCount);
+			for (int i = 0; i < unknownCount; ++i)
+			{
+				toFactorIdx[i] = entry.vertexToFactorIdx.at(vertexIndices[i]);
+			}
+
+			auto const ApplyOperator = [&](Eigen::MatrixX3d const & x, Eigen::MatrixX3d & outY)->void
+			{
+				Eigen::MatrixX3d const Bx = B * x;
+				Eigen::MatrixX3d const Yx = Y * x;
+				outY = (B.transpose() * Bx) * (1.0 - laplacianWeight) + (Y.transpose() * Yx) * laplacianWeight;
+			};
+
+			Eigen::MatrixX3d factorR(unknownCount, 3);
+			auto const ApplyPreconditioner = [&](Eigen::MatrixX3d const & r, Eigen::MatrixX3d & outZ)->void
+			{
+				for (int i = 0; i < unknownCount; ++i)
+				{
+					factorR.row(toFactorIdx[i]) = r.row(i);
+				}
+				Eigen::MatrixX3d const factorZ = entry.factor.solve(factorR);
+				outZ.resize(unknownCount, 3);
+				for (int i = 0; i < unknownCount; ++i)
+				{
+					outZ.row(i) = factorZ.row(toFactorIdx[i]);
+				}
+			};
+
+			// The previous solution is only a good guess if the stroke is similar, otherwise start from zero
+			Eigen::MatrixX3d warmStart(unknownCount, 3);
+			for (int i = 0; i < unknownCount; ++i)
+			{
+				warmStart.row(i) = entry.lastSolution.row(toFactorIdx[i]);
+			}
+			Eigen::MatrixX3d warmStartAx{};
+			ApplyOperator(warmStart, warmStartAx);
+			if ((rhs - warmStartAx).norm() < rhs.norm())
+			{
+				outX = std::move(warmStart);
+			}
+			else
+			{
+				outX = Eigen::MatrixX3d::Zero(unknownCount, 3);
+			}
+
+			auto const result = SolveConjugateGradient(
+				ApplyOperator,
+				ApplyPreconditioner,
+				rhs,
+				outX,
+				_options.maxIterations,
+				_options.tolerance,
+				cancelRequested
+			);
+			blockResult.iterationCount = result.iterationCount;
+
+			// The factor is still valid, only the solution of this call is discarded
+			if (result.cancelled == true)
+			{
+				return blockResult;
+			}
+
+			if (result.converged == true)
+			{
+				for (int i = 0; i < unknownCount; ++i)
+				{
+					entry.lastSolution.row(toFactorIdx[i]) = outX.row(i);
+				}
+				blockResult.cached = true;
+				return blockResult;
+			}
+		}
+
+		// A factorization can not be interrupted, so it is not started for a cancelled solve
+		if (IsCancelRequested(cancelRequested) == true)
+		{
+			if (isFactored == false)
+			{
+				Invalidate(entry);
+			}
+			return blockResult;
+		}
+
+		// Stroke differs too much from the one that was factored (or nothing was cached)
+		if (Factor(entry, laplacianWeight, vertexIndices, B, Y) == false)
+		{
+			outX = Eigen::MatrixX3d::Zero(unknownCount, 3);
+			blockResult.factored = false;
+			return blockResult;
+		}
+
+		outX = entry.factor.solve(rhs);
+		entry.lastSolution = outX;
+
+		return blockResult;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void FactorizationCache::Clear()
+	{
+		_entries.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool FactorizationCache::WasLastSolveCached() const
+	{
+		return _lastSolveCached;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	int FactorizationCache::GetLastIterationCount() const
+	{
+		return _lastIterationCount;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void FactorizationCache::Invalidate(Entry & entry)
+	{
+		// No region is solved at level -1
+		entry.level = -1;
+		entry.sortedIndices.clear();
+		entry.vertexToFactorIdx.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	FactorizationCache::Entry * FactorizationCache::Find(
+		int const level,
+		double const laplacianWeight,
+		size_t const regionHash,
+		std::vector<int> const & sortedIndices
+	)
+	{
+		for (auto & entry : _entries)
+		{
+			if (
+				entry->level == level &&
+				entry->laplacianWeight == laplacianWeight &&
+				entry->regionHash == regionHash &&
+				entry->sortedIndices == sortedIndices
+			)
+			{
+				return entry.get();
+			}
+		}
+		return nullptr;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool FactorizationCache::Factor(
+		Entry & entry,
+		double const laplacianWeight,
+		std::vector<int> const & vertexIndices,
+		SparseMatrix const & B,
+		SparseMatrix const & Y
+	)
+	{
+		bool const factored = FactorRegularized(
+			SparseMatrix(B.transpose() * B) * (1.0 - laplacianWeight) +
+			SparseMatrix(Y.transpose() * Y) * laplacianWeight,
+			entry.factor
+		);
+		if (factored == false)
+		{
+			MFA_LOG_WARN("Failed to factor a region of %d unknowns", static_cast<int>(vertexIndices.size()));
+			Invalidate(entry);
+			return false;
+		}
+
+		entry.vertexToFactorIdx.clear();
+		entry.vertexToFactorIdx.reserve(vertexIndices.size());
+		for (int i = 0; i < static_cast<int>(vertexIndices.size()); ++i)
+		{
+			entry.vertexToFactorIdx[vertexIndices[i]] = i;
+		}
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	FactorizationCache::Entry & FactorizationCache::Insert(uint64_t const protectedFrom)
+	{
+		std::unique_ptr<Entry> * slot = nullptr;
+		if (static_cast<int>(_entries.size()) < _options.capacity)
+		{
+			slot = &_entries.emplace_back();
+		}
+		else
+		{
+			for (auto & entry : _entries)
+			{
+				if (entry->lastUse < protectedFrom && (slot == nullptr || entry->lastUse < (*slot)->lastUse))
+				{
+					slot = &entry;
+				}
+			}
+			if (slot == nullptr)
+			{
+				slot = &_entries.emplace_back();
+			}
+		}
+
+		*slot = std::make_unique<Entry>();
+		(*slot)->lastUse = ++_useCounter;
+		return **slot;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void FactorizationCache::Trim()
+	{
+		while (static_cast<int>(_entries.size()) > _options.capacity)
+		{
+			auto const leastRecent = std::min_element(
+				_entries.begin(),
+				_entries.end(),
+				[](std::unique_ptr<Entry> const & a, std::unique_ptr<Entry> const & b)->bool
+				{
+					return a->lastUse < b->lastUse;
+				}
+			);
+			_entries.erase(leastRecent);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
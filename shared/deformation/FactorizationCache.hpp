@@ -0,0 +1,142 @@
+#pragma once
+
+#include "LinearSolve.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace shared
+{
+    // Solves the deformation normal equations ((1 - w) B^T B + w Y^T Y) x = rhs and keeps the factorization of
+    // the last few regions. The laplacian part only depends on the topology of the region, so a later stroke over
+    // the same (level, region vertex set, weight) only changes the B^T B term: it is solved with conjugate gradient
+    // preconditioned by the cached factor and warm-started from the previous solution of that region.
+    // If that does not converge quickly the region is refactored and the cache entry replaced.
+    class FactorizationCache
+    {
+    public:
+
+        using SparseMatrix = SparseSolveMatrix;
+
+        struct Options
+        {
+            int maxIterations = 30;             // Iterations allowed with a cached factor before refactoring
+            double tolerance = 1e-6;            // Relative to the norm of the right hand side
+            int capacity = 4;                   // Number of regions that are kept
+        };
+
+        // Independent system of a stroke, blocks never share unknowns
+        struct Block
+        {
+            std::vector<int> const * vertexIndices = nullptr;
+            SparseMatrix const * B = nullptr;
+            SparseMatrix const * Y = nullptr;
+            Eigen::MatrixX3d const * rhs = nullptr;
+            Eigen::MatrixX3d * outX = nullptr;
+        };
+
+        explicit FactorizationCache(Options const & options);
+
+        // Unknown i is vertex vertexIndices[i] of the level, the order may change between calls.
+        // Returns false if the system could not be factored, outX is zero in that case.
+        // Cancelling stops the conjugate gradient iterations and skips any refactoring, outX is undefined then.
+        [[nodiscard]]
+        bool Solve(
+            int level,
+            double laplacianWeight,
+            std::vector<int> const & vertexIndices,
+            SparseMatrix const & B,
+            SparseMatrix const & Y,
+            Eigen::MatrixX3d const & rhs,
+            Eigen::MatrixX3d & outX,
+            std::atomic<bool> const * cancelRequested = nullptr
+        );
+
+        // Solves the blocks concurrently, each of them is cached as its own region.
+        // Returns false if any block could not be factored, the solution of such a block is zero.
+        [[nodiscard]]
+        bool Solve(
+            int level,
+            double laplacianWeight,
+            std::vector<Block> const & blocks,
+            std::atomic<bool> const * cancelRequested = nullptr
+        );
+
+        void Clear();
+
+        // True only if every block of the last call was solved with a cached factor
+        [[nodiscard]]
+        bool WasLastSolveCached() const;
+
+
+        // Maximum over the blocks of the last call
+        [[nodiscard]]
+        int GetLastIterationCount() const;
+
+    private:
+
+        struct Entry
+        {
+            int level = -1;
+            double laplacianWeight = 0.0;
+            size_t regionHash = 0;
+            std::vector<int> sortedIndices{};                   // Key
+            std::unordered_map<int, int> vertexToFactorIdx{};   // Unknown order of the factor
+            SparseLDLT factor{};
+            Eigen::MatrixX3d lastSolution{};                    // In factor order
+            uint64_t lastUse = 0;
+        };
+
+        struct BlockResult
+        {
+            bool cached = false;
+            bool factored = true;
+            int iterationCount = 0;
+        };
+
+        // Only touches the entry so blocks can be solved in parallel
+        [[nodiscard]]
+        BlockResult SolveBlock(
+            Entry & entry,
+            bool isFactored,
+            double laplacianWeight,
+            Block const & block,
+            std::atomic<bool> const * cancelRequested
+        ) const;
+
+        // An invalid entry never matches a lookup and is evicted like any other unused one
+        static void Invalidate(Entry & entry);
+
+        [[nodiscard]]
+        Entry * Find(int level, double laplacianWeight, size_t regionHash, std::vector<int> const & sortedIndices);
+
+        // Factors the current system into the entry, the unknowns keep the order of vertexIndices.
+        // Returns false if the system could not be factored, the entry is invalidated then.
+        [[nodiscard]]
+        static bool Factor(
+            Entry & entry,
+            double laplacianWeight,
+            std::vector<int> const & vertexIndices,
+            SparseMatrix const & B,
+            SparseMatrix const & Y
+        );
+
+        // Evicts the least recently used entry if there is no room. Entries used since protectedFrom are kept,
+        // the cache grows past its capacity instead and is trimmed by Trim.
+        [[nodiscard]]
+        Entry & Insert(uint64_t protectedFrom);
+
+        void Trim();
+
+        Options _options{};
+        std::vector<std::unique_ptr<Entry>> _entries{};
+        uint64_t _useCounter = 0;
+
+        bool _lastSolveCached = false;
+        int _lastIterationCount = 0;
+
+    };
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Eigen/Sparse>
+
+#include <algorithm>
+#include <atomic>
+
+namespace shared
+{
+    using SparseSolveMatrix = Eigen::SparseMatrix<double>;
+    using SparseLDLT = Eigen::SimplicialLDLT<SparseSolveMatrix>;
+
+    // Factors the symmetric matrix, a rank deficient matrix (e.g. vertices without any constraint) is retried with a
+    // tiny diagonal regularization which picks the solution that keeps the unconstrained unknowns in place.
+    // Returns false if even the regularized matrix could not be factored, outSolver must not be used then.
+    [[nodiscard]]
+    inline bool FactorRegularized(SparseSolveMatrix matrix, SparseLDLT & outSolver)
+    {
+        outSolver.compute(matrix);
+        if (outSolver.info() == Eigen::Success)
+        {
+            return true;
+        }
+
+        double const epsilon = 1e-8 * std::max(matrix.diagonal().cwiseAbs().maxCoeff(), 1.0);
+        SparseSolveMatrix identity(matrix.rows(), matrix.cols());
+        identity.setIdentity();
+        matrix += identity * epsilon;
+        outSolver.compute(matrix);
+        return outSolver.info() == Eigen::Success;
+    }
+
+    //-----------------------------------------------------------------------------------------
+
+    // Iterative solvers poll the flag once per iteration, a null flag never cancels
+    [[nodiscard]]
+    inline bool IsCancelRequested(std::atomic<bool> const * cancelRequested)
+    {
+        return cancelRequested != nullptr && cancelRequested->load(std::memory_order_relaxed) == true;
+    }
+
+    //-----------------------------------------------------------------------------------------
+
+    struct ConjugateGradientResult
+    {
+        bool converged = false;
+        bool cancelled = false;
+        int iterationCount = 0;
+    };
+
+    // Preconditioned conjugate gradient that iterates the three columns of x together, each with its own step sizes.
+    // Operator and preconditioner signature: void(Eigen::MatrixX3d const & in, Eigen::MatrixX3d & out).
+    // Both have to be symmetric positive (semi-)definite. x is used as the initial guess.
+    // A cancelled solve returns right away, x is the last iterate then.
+    template<typename ApplyOperator, typename ApplyPreconditioner>
+    ConjugateGradientResult SolveConjugateGradient(
+        ApplyOperator && applyOperator,
+        ApplyPreconditioner && applyPreconditioner,
+        Eigen::MatrixX3d const & rhs,
+        Eigen::MatrixX3d & inOutX,
+        int const maxIterations,
+        double const tolerance,                 // Relative to the norm of the right hand side
+        std::atomic<bool> const * cancelRequested = nullptr
+    )
+    {
+        if (inOutX.rows() != rhs.rows())
+        {
+            inOutX = Eigen::MatrixX3d::Zero(rhs.rows(), 3);
+        }
+
+        Eigen::RowVector3d const targetNorm = (rhs.colwise().norm() * tolerance).cwiseMax(1e-30);
+
+        Eigen::MatrixX3d Ap{};
+        applyOperator(inOutX, Ap);
+        Eigen::MatrixX3d r = rhs - Ap;
+
+        auto const IsConverged = [&]()->bool
+        {
+            return (r.colwise().norm().array() <= targetNorm.array()).all();
+        };
+
+        ConjugateGradientResult result{};
+        if (IsConverged() == true)
+        {
+            result.converged = true;
+            return result;
+        }
+
+        Eigen::MatrixX3d z{};
+        applyPreconditioner(r, z);
+        Eigen::MatrixX3d p = z;
+        Eigen::RowVector3d rz = r.cwiseProduct(z).colwise().sum();
+
+        for (int itr = 0; itr < maxIterations; ++itr)
+        {
+            if (IsCancelRequested(cancelRequested) == true)
+            {
+                result.cancelled = true;
+                return result;
+            }
+
+            applyOperator(p, Ap);
+            Eigen::RowVector3d const pAp = p.cwiseProduct(Ap).colwise().sum();
+
+            Eigen::RowVector3d alpha{};
+            for (int col = 0; col < 3; ++col)
+            {
+                alpha[col] = pAp[col] > 0.0 ? rz[col] / pAp[col] : 0.0;
+            }
+            inOutX += p * alpha.asDiagonal();
+            r -= Ap * alpha.asDiagonal();
+
+            result.iterationCount = itr + 1;
+            if (IsConverged() == true)
+            {
+                result.converged = true;
+                return result;
+            }
+
+            applyPreconditioner(r, z);
+            Eigen::RowVector3d const nextRz = r.cwiseProduct(z).colwise().sum();
+            Eigen::RowVector3d beta{};
+            for (int col = 0; col < 3; ++col)
+            {
+                beta[col] = rz[col] != 0.0 ? nextRz[col] / rz[col] : 0.0;
+            }
+            p = z + p * beta.asDiagonal();
+            rz = nextRz;
+        }
+
+        return result;
+    }
+}
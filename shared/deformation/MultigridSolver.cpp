@@ -0,0 +1,250 @@
+#include "MultigridSolver.hpp"
+
+#include "BedrockAssert.hpp"
+#include "BedrockLog.hpp"
+#include "LinearSolve.hpp"
+
+#include <unordered_map>
+
+namespace shared
+{
+
+	//-----------------------------------------------------------------------------------------
+
+	namespace
+	{
+		// Squared norm of every column
+		Eigen::VectorXd CalcColumnSquaredNorms(MultigridSolver::SparseMatrix const & matrix)
+		{
+			Eigen::VectorXd result = Eigen::VectorXd::Zero(matrix.cols());
+			for (int col = 0; col < matrix.outerSize(); ++col)
+			{
+				for (MultigridSolver::SparseMatrix::InnerIterator itr(matrix, col); itr; ++itr)
+				{
+					result[col] += itr.value() * itr.value();
+				}
+			}
+			return result;
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	MultigridSolver::MultigridSolver(
+		SparseMatrix B,
+		SparseMatrix Y,
+		double const laplacianWeight,
+		ContributionMapList const & contributionMaps,
+		int const fineLvl,
+		std::vector<int> const & vertexIndices,
+		Options const & options
+	)
+		: _fitWeight(1.0 - laplacianWeight)
+		, _laplacianWeight(laplacianWeight)
+		, _options(options)
+	{
+		MFA_ASSERT(B.cols() == static_cast<Eigen::Index>(vertexIndices.size()));
+		MFA_ASSERT(Y.cols() == static_cast<Eigen::Index>(vertexIndices.size()));
+		MFA_ASSERT(fineLvl <= static_cast<int>(contributionMaps.size()));
+
+		_grids.emplace_back(Grid{ .B = std::move(B), .Y = std::move(Y) });
+
+		std::vector<int> indices = vertexIndices;
+		for (int lvl = fineLvl; lvl > 0 && static_cast<int>(indices.size()) > _options.coarsestVertexCount; --lvl)
+		{
+			std::vector<int> coarseIndices{};
+			SparseMatrix prolongation = BuildProlongation(*contributionMaps[lvl - 1], indices, coarseIndices);
+
+			// Small regions are mostly border, their coarse support is barely smaller than the region itself
+			if (coarseIndices.size() * 10 > indices.size() * 9)
+			{
+				break;
+			}
+
+			auto & fineGrid = _grids.back();
+			Grid coarseGrid{
+				.B = fineGrid.B * prolongation,
+				.Y = fineGrid.Y * prolongation
+			};
+			fineGrid.prolongation = std::move(prolongation);
+			_grids.emplace_back(std::move(coarseGrid));
+
+			indices = std::move(coarseIndices);
+		}
+
+		for (auto & grid : _grids)
+		{
+			Eigen::VectorXd const diagonal =
+				CalcColumnSquaredNorms(grid.B) * _fitWeight +
+				CalcColumnSquaredNorms(grid.Y) * _laplacianWeight;
+			grid.inverseDiagonal = diagonal.unaryExpr([](double const value)->double
+			{
+				return value > 0.0 ? 1.0 / value : 0.0;
+			});
+		}
+
+		auto const & coarsestGrid = _grids.back();
+		_isFactored = FactorRegularized(
+			SparseMatrix(coarsestGrid.B.transpose() * coarsestGrid.B) * _fitWeight +
+			SparseMatrix(coarsestGrid.Y.transpose() * coarsestGrid.Y) * _laplacianWeight,
+			_coarsestSolver
+		);
+		if (_isFactored == false)
+		{
+			MFA_LOG_WARN("Failed to factor the coarsest multigrid level of %d unknowns", static_cast<int>(indices.size()));
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool MultigridSolver::Solve(
+		Eigen::MatrixX3d const & rhs,
+		Eigen::MatrixX3d & inOutX,
+		std::atomic<bool> const * cancelRequested
+	) const
+	{
+		auto const & fineGrid = _grids.front();
+		MFA_ASSERT(rhs.rows() == fineGrid.B.cols());
+
+		if (_isFactored == false)
+		{
+			inOutX = Eigen::MatrixX3d::Zero(rhs.rows(), 3);
+			_lastIterationCount = 0;
+			return false;
+		}
+
+		auto const result = SolveConjugateGradient(
+			[&](Eigen::MatrixX3d const & x, Eigen::MatrixX3d & outY)->void
+			{
+				ApplyOperator(fineGrid, x, outY);
+			},
+			[&](Eigen::MatrixX3d const & r, Eigen::MatrixX3d & outZ)->void
+			{
+				VCycle(0, r, outZ);
+			},
+			rhs,
+			inOutX,
+			_options.maxIterations,
+			_options.tolerance,
+			cancelRequested
+		);
+		_lastIterationCount = result.iterationCount;
+
+		if (result.converged == false && result.cancelled == false)
+		{
+			MFA_LOG_WARN("Multigrid solver did not converge in %d iterations", _options.maxIterations);
+		}
+		return result.converged;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool MultigridSolver::IsFactored() const
+	{
+		return _isFactored;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	int MultigridSolver::GetLastIterationCount() const
+	{
+		return _lastIterationCount;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	int MultigridSolver::GetGridCount() const
+	{
+		return static_cast<int>(_grids.size());
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	MultigridSolver::SparseMatrix MultigridSolver::BuildProlongation(
+		ContributionMap const & contributionMap,
+		std::vector<int> const & fineIndices,
+		std::vector<int> & outCoarseIndices
+	)
+	{
+		outCoarseIndices.clear();
+		std::unordered_map<int, int> coarseGToLIdx{};
+
+		std::vector<Eigen::Triplet<double>> triplets{};
+		for (int fineLIdx = 0; fineLIdx < static_cast<int>(fineIndices.size()); ++fineLIdx)
+		{
+			contributionMap.ForEachNextLvlContrib(
+				fineIndices[fineLIdx],
+				[&](int const coarseGIdx, float const amount)->void
+				{
+					auto const [itr, inserted] = coarseGToLIdx.try_emplace(
+						coarseGIdx,
+						static_cast<int>(outCoarseIndices.size())
+					);
+					if (inserted == true)
+					{
+						outCoarseIndices.emplace_back(coarseGIdx);
+					}
+					triplets.emplace_back(fineLIdx, itr->second, amount);
+				}
+			);
+		}
+
+		SparseMatrix result(
+			static_cast<Eigen::Index>(fineIndices.size()),
+			static_cast<Eigen::Index>(outCoarseIndices.size())
+		);
+		result.setFromTriplets(triplets.begin(), triplets.end());
+		return result;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void MultigridSolver::ApplyOperator(Grid const & grid, Eigen::MatrixX3d const & x, Eigen::MatrixX3d & outY) const
+	{
+		Eigen::MatrixX3d const Bx = grid.B * x;
+		Eigen::MatrixX3d const Yx = grid.Y * x;
+		outY = (grid.B.transpose() * Bx) * _fitWeight + (grid.Y.transpose() * Yx) * _laplacianWeight;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void MultigridSolver::Smooth(Grid const & grid, Eigen::MatrixX3d const & rhs, Eigen::MatrixX3d & inOutX) const
+	{
+		Eigen::MatrixX3d Ax{};
+		for (int step = 0; step < _options.smoothingSteps; ++step)
+		{
+			ApplyOperator(grid, inOutX, Ax);
+			inOutX += (grid.inverseDiagonal.asDiagonal() * (rhs - Ax)) * _options.jacobiDamping;
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void MultigridSolver::VCycle(int const gridIdx, Eigen::MatrixX3d const & rhs, Eigen::MatrixX3d & outX) const
+	{
+		if (gridIdx == static_cast<int>(_grids.size()) - 1)
+		{
+			outX = _coarsestSolver.solve(rhs);
+			return;
+		}
+
+		auto const & grid = _grids[gridIdx];
+
+		// Same number of pre and post smoothing steps keeps the cycle symmetric, which conjugate gradient needs
+		outX = Eigen::MatrixX3d::Zero(rhs.rows(), 3);
+		Smooth(grid, rhs, outX);
+
+		Eigen::MatrixX3d Ax{};
+		ApplyOperator(grid, outX, Ax);
+		Eigen::MatrixX3d const coarseRhs = grid.prolongation.transpose() * (rhs - Ax);
+
+		Eigen::MatrixX3d coarseX{};
+		VCycle(gridIdx + 1, coarseRhs, coarseX);
+		outX += grid.prolongation * coarseX;
+
+		Smooth(grid, rhs, outX);
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
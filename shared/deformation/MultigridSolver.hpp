@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Contribution.hpp"
+
+#include <Eigen/Sparse>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace shared
+{
+    // Matrix-free preconditioned conjugate gradient for the deformation least squares problem
+    //      ((1 - w) B^T B + w Y^T Y) x = rhs
+    // where the unknowns are a region of vertices at one subdivision level. The preconditioner is a V-cycle whose
+    // coarse grids are the coarser subdivision levels: the subdivision stencils restricted to the region are the
+    // prolongation and their transpose the restriction. Coarse operators are kept in factored form (B P, Y P),
+    // so the normal matrix is never formed and memory stays linear in the size of the region.
+    class MultigridSolver
+    {
+    public:
+
+        using SparseMatrix = Eigen::SparseMatrix<double>;
+        using ContributionMapList = std::vector<std::shared_ptr<ContributionMap>>;
+
+        struct Options
+        {
+            int maxIterations = 200;
+            double tolerance = 1e-6;            // Relative to the norm of the right hand side
+            int smoothingSteps = 2;
+            double jacobiDamping = 0.6;
+            int coarsestVertexCount = 512;      // Levels at or below this size are factored directly
+        };
+
+        // B: points x unknowns, Y: laplacian rows x unknowns.
+        // contributionMaps[i] must map level i to level i + 1, unknown i is vertex vertexIndices[i] of fineLvl.
+        explicit MultigridSolver(
+            SparseMatrix B,
+            SparseMatrix Y,
+            double laplacianWeight,
+            ContributionMapList const & contributionMaps,
+            int fineLvl,
+            std::vector<int> const & vertexIndices,
+            Options const & options
+        );
+
+        // x is used as the initial guess, all three columns are iterated together.
+        // Returns false if the tolerance was not reached within the iteration limit or the solve was cancelled.
+        // If the coarsest grid could not be factored nothing is solved, x is set to zero and false is returned.
+        bool Solve(
+            Eigen::MatrixX3d const & rhs,
+            Eigen::MatrixX3d & inOutX,
+            std::atomic<bool> const * cancelRequested = nullptr
+        ) const;
+
+        // False if the coarsest grid could not be factored, the solver is unusable then
+        [[nodiscard]]
+        bool IsFactored() const;
+
+        [[nodiscard]]
+        int GetLastIterationCount() const;
+
+        [[nodiscard]]
+        int GetGridCount() const;
+
+    private:
+
+        struct Grid
+        {
+            SparseMatrix B{};
+            SparseMatrix Y{};
+            SparseMatrix prolongation{};        // Next (coarser) grid to this grid, empty for the coarsest one
+            Eigen::VectorXd inverseDiagonal{};
+        };
+
+        [[nodiscard]]
+        static SparseMatrix BuildProlongation(
+            ContributionMap const & contributionMap,
+            std::vector<int> const & fineIndices,
+            std::vector<int> & outCoarseIndices
+        );
+
+        void ApplyOperator(Grid const & grid, Eigen::MatrixX3d const & x, Eigen::MatrixX3d & outY) const;
+
+        void Smooth(Grid const & grid, Eigen::MatrixX3d const & rhs, Eigen::MatrixX3d & inOutX) const;
+
+        void VCycle(int gridIdx, Eigen::MatrixX3d const & rhs, Eigen::MatrixX3d & outX) const;
+
+        double _fitWeight = 0.0;
+        double _laplacianWeight = 0.0;
+        Options _options{};
+
+        std::vector<Grid> _grids{};                                     // Finest first
+        Eigen::SimplicialLDLT<SparseMatrix> _coarsestSolver{};
+        bool _isFactored = false;
+
+        mutable int _lastIterationCount = 0;
+
+    };
+}
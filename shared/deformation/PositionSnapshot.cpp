@@ -0,0 +1,48 @@
+#include "PositionSnapshot.hpp"
+
+#include "BedrockAssert.hpp"
+
+namespace shared
+{
+
+	//-----------------------------------------------------------------------------------------
+
+	void PositionSnapshot::Save(int const level, std::vector<int> const & vertexIndices, Positions const & positions)
+	{
+		MFA_ASSERT(level >= 0);
+		if (level >= static_cast<int>(_levels.size()))
+		{
+			_levels.resize(level + 1);
+		}
+
+		auto & saved = _levels[level];
+		saved.vertexIndices = vertexIndices;
+		saved.positions.resize(vertexIndices.size());
+		for (int i = 0; i < static_cast<int>(vertexIndices.size()); ++i)
+		{
+			saved.positions[i] = positions[vertexIndices[i]];
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void PositionSnapshot::Restore(int const level, Positions & inOutPositions) const
+	{
+		MFA_ASSERT(level >= 0 && level < static_cast<int>(_levels.size()));
+		auto const & saved = _levels[level];
+		for (int i = 0; i < static_cast<int>(saved.vertexIndices.size()); ++i)
+		{
+			inOutPositions[saved.vertexIndices[i]] = saved.positions[i];
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void PositionSnapshot::Clear()
+	{
+		_levels.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <geometrycentral/surface/vertex_position_geometry.h>
+#include <geometrycentral/utilities/vector3.h>
+
+#include <vector>
+
+namespace shared
+{
+    // Positions of some vertices of each level, saved before a temporary change so it can be taken back exactly.
+    // Subtracting the deltas again does not restore them, p + d - d is not always p in floating point.
+    class PositionSnapshot
+    {
+    public:
+
+        using Vector3 = geometrycentral::Vector3;
+        using Positions = geometrycentral::surface::VertexData<Vector3>;
+
+        // Saves the current position of every given vertex, replaces what was saved for the level before
+        void Save(int level, std::vector<int> const & vertexIndices, Positions const & positions);
+
+        // Writes the saved positions of the level back, the level must have been saved
+        void Restore(int level, Positions & inOutPositions) const;
+
+        void Clear();
+
+    private:
+
+        struct Level
+        {
+            std::vector<int> vertexIndices{};
+            std::vector<Vector3> positions{};
+        };
+
+        std::vector<Level> _levels{};       // Indexed by level
+
+    };
+}
@@ -0,0 +1,514 @@
+#include "QuadGridMesh.hpp"
+
+#include "BedrockAssert.hpp"
+
+namespace shared
+{
+
+	using namespace geometrycentral;
+	using namespace geometrycentral::surface;
+
+	//--------------------------------------------------------------------------------------------------------
+
+	QuadGridMesh::QuadGridMesh(Mesh & baseMesh, Geometry const & baseGeometry)
+	{
+		MFA_ASSERT(baseMesh.isCompressed() == true);
+		MFA_ASSERT(baseMesh.hasBoundary() == false);
+
+		auto topology = std::make_shared<Topology>();
+		topology->vertexCount = static_cast<int>(baseMesh.nVertices());
+		topology->edgeCount = static_cast<int>(baseMesh.nEdges());
+		topology->faceCount = static_cast<int>(baseMesh.nFaces());
+
+		int const nVertices = topology->vertexCount;
+		int const nEdges = topology->edgeCount;
+		int const nFaces = topology->faceCount;
+
+		auto const SideOf = [](Halfedge const he)->int
+		{
+			int side = 0;
+			for (Halfedge itr = he.face().halfedge(); itr != he; itr = itr.next())
+			{
+				++side;
+			}
+			MFA_ASSERT(side < 4);
+			return side;
+		};
+
+		topology->faceCorners.resize(nFaces);
+		topology->faceEdges.resize(nFaces);
+		topology->faceEdgeForward.resize(nFaces);
+		topology->neighborFaces.resize(nFaces);
+		topology->neighborSides.resize(nFaces);
+		#pragma omp parallel for
+		for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+		{
+			Face const f = baseMesh.face(fIdx);
+			MFA_ASSERT(f.degree() == 4);
+
+			Halfedge he = f.halfedge();
+			for (int side = 0; side < 4; ++side)
+			{
+				Halfedge const twin = he.twin();
+
+				topology->faceCorners[fIdx][side] = static_cast<int>(he.vertex().getIndex());
+				topology->faceEdges[fIdx][side] = static_cast<int>(he.edge().getIndex());
+				topology->faceEdgeForward[fIdx][side] = he.edge().halfedge() == he ? 1 : 0;
+				topology->neighborFaces[fIdx][side] = static_cast<int>(twin.face().getIndex());
+				topology->neighborSides[fIdx][side] = SideOf(twin);
+
+				he = he.next();
+			}
+		}
+
+		topology->edgeFaces.resize(nEdges);
+		topology->edgeSides.resize(nEdges);
+		#pragma omp parallel for
+		for (int eIdx = 0; eIdx < nEdges; ++eIdx)
+		{
+			Halfedge const he = baseMesh.edge(eIdx).halfedge();
+			topology->edgeFaces[eIdx] = static_cast<int>(he.face().getIndex());
+			topology->edgeSides[eIdx] = SideOf(he);
+		}
+
+		topology->vertexOffsets.assign(nVertices + 1, 0);
+		for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+		{
+			for (auto const vIdx : topology->faceCorners[fIdx])
+			{
+				++topology->vertexOffsets[vIdx + 1];
+			}
+		}
+		for (int vIdx = 0; vIdx < nVertices; ++vIdx)
+		{
+			topology->vertexOffsets[vIdx + 1] += topology->vertexOffsets[vIdx];
+		}
+		std::vector<int> cursors(topology->vertexOffsets.begin(), topology->vertexOffsets.end() - 1);
+		topology->vertexCorners.resize(topology->vertexOffsets.back());
+		for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+		{
+			for (int corner = 0; corner < 4; ++corner)
+			{
+				topology->vertexCorners[cursors[topology->faceCorners[fIdx][corner]]++] = { fIdx, corner };
+			}
+		}
+
+		_topology = std::move(topology);
+		_resolution = 1;
+
+		_positions.resize(nVertices);
+		#pragma omp parallel for
+		for (int vIdx = 0; vIdx < nVertices; ++vIdx)
+		{
+			_positions[vIdx] = baseGeometry.vertexPositions[vIdx];
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	QuadGridMesh::QuadGridMesh(std::shared_ptr<Topology const> topology, int const resolution)
+		: _topology(std::move(topology))
+		, _resolution(resolution)
+	{
+		_positions.resize(CalcVertexCount(*_topology, _resolution));
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	std::unique_ptr<QuadGridMesh> QuadGridMesh::Subdivide(bool const parallel) const
+	{
+		auto const & topology = *_topology;
+		int const N = _resolution;
+		int const M = _resolution * 2;
+
+		std::unique_ptr<QuadGridMesh> result(new QuadGridMesh(_topology, M));
+
+		auto const & prevPositions = _positions;
+		auto & positions = result->_positions;
+
+		auto const Prev = [&](int const fIdx, GridCoord const & coord)->Vector3 const &
+		{
+			return prevPositions[PointIndex(topology, N, fIdx, coord)];
+		};
+		auto const Next = [&](int const fIdx, GridCoord const & coord)->Vector3 &
+		{
+			return positions[PointIndex(topology, M, fIdx, coord)];
+		};
+
+		// Every phase only reads the previous level and the output of the earlier phases, so the result
+		// does not depend on the number of threads.
+
+		// Face points
+		#pragma omp parallel for if(parallel)
+		for (int fIdx = 0; fIdx < topology.faceCount; ++fIdx)
+		{
+			for (int j = 0; j < N; ++j)
+			{
+				for (int i = 0; i < N; ++i)
+				{
+					Next(fIdx, { 2 * i + 1, 2 * j + 1 }) = (
+						Prev(fIdx, { i, j }) +
+						Prev(fIdx, { i + 1, j }) +
+						Prev(fIdx, { i + 1, j + 1 }) +
+						Prev(fIdx, { i, j + 1 })
+					) / 4.0;
+				}
+			}
+		}
+
+		// Edge points inside the grids
+		#pragma omp parallel for if(parallel)
+		for (int fIdx = 0; fIdx < topology.faceCount; ++fIdx)
+		{
+			for (int j = 1; j < N; ++j)
+			{
+				for (int i = 0; i < N; ++i)
+				{
+					Next(fIdx, { 2 * i + 1, 2 * j }) = (Next(fIdx, { 2 * i + 1, 2 * j - 1 }) + Next(fIdx, { 2 * i + 1, 2 * j + 1 })) / 2.0;
+				}
+			}
+			for (int j = 0; j < N; ++j)
+			{
+				for (int i = 1; i < N; ++i)
+				{
+					Next(fIdx, { 2 * i, 2 * j + 1 }) = (Next(fIdx, { 2 * i - 1, 2 * j + 1 }) + Next(fIdx, { 2 * i + 1, 2 * j + 1 })) / 2.0;
+				}
+			}
+		}
+
+		// Edge points on the base edges, both sides of the edge are in different grids
+		#pragma omp parallel for if(parallel)
+		for (int eIdx = 0; eIdx < topology.edgeCount; ++eIdx)
+		{
+			int const fIdx = topology.edgeFaces[eIdx];
+			int const side = topology.edgeSides[eIdx];
+			int const nfIdx = topology.neighborFaces[fIdx][side];
+			int const nSide = topology.neighborSides[fIdx][side];
+
+			for (int t = 1; t < M; t += 2)
+			{
+				Next(fIdx, SideCoord(M, side, t, 0)) = (
+					Next(fIdx, SideCoord(M, side, t, 1)) +
+					Next(nfIdx, SideCoord(M, nSide, M - t, 1))
+				) / 2.0;
+			}
+		}
+
+		// Vertex points, (Q + 2R + (D - 3)S) / D
+		auto const VertexPoint = [](Vector3 const & Q, Vector3 const & R, Vector3 const & S, double const D)->Vector3
+		{
+			return (Q + 2 * R + (D - 3) * S) / D;
+		};
+
+		#pragma omp parallel for if(parallel)
+		for (int fIdx = 0; fIdx < topology.faceCount; ++fIdx)
+		{
+			for (int j = 1; j < N; ++j)
+			{
+				for (int i = 1; i < N; ++i)
+				{
+					int const ni = 2 * i;
+					int const nj = 2 * j;
+					Vector3 const Q = (
+						Next(fIdx, { ni - 1, nj - 1 }) +
+						Next(fIdx, { ni + 1, nj - 1 }) +
+						Next(fIdx, { ni + 1, nj + 1 }) +
+						Next(fIdx, { ni - 1, nj + 1 })
+					) / 4.0;
+					Vector3 const R = (
+						Next(fIdx, { ni - 1, nj }) +
+						Next(fIdx, { ni + 1, nj }) +
+						Next(fIdx, { ni, nj - 1 }) +
+						Next(fIdx, { ni, nj + 1 })
+					) / 4.0;
+					Next(fIdx, { ni, nj }) = VertexPoint(Q, R, Prev(fIdx, { i, j }), 4.0);
+				}
+			}
+		}
+
+		#pragma omp parallel for if(parallel)
+		for (int eIdx = 0; eIdx < topology.edgeCount; ++eIdx)
+		{
+			int const fIdx = topology.edgeFaces[eIdx];
+			int const side = topology.edgeSides[eIdx];
+			int const nfIdx = topology.neighborFaces[fIdx][side];
+			int const nSide = topology.neighborSides[fIdx][side];
+
+			for (int t = 1; t < N; ++t)
+			{
+				int const nt = 2 * t;
+				Vector3 const Q = (
+					Next(fIdx, SideCoord(M, side, nt - 1, 1)) +
+					Next(fIdx, SideCoord(M, side, nt + 1, 1)) +
+					Next(nfIdx, SideCoord(M, nSide, M - nt - 1, 1)) +
+					Next(nfIdx, SideCoord(M, nSide, M - nt + 1, 1))
+				) / 4.0;
+				Vector3 const R = (
+					Next(fIdx, SideCoord(M, side, nt - 1, 0)) +
+					Next(fIdx, SideCoord(M, side, nt + 1, 0)) +
+					Next(fIdx, SideCoord(M, side, nt, 1)) +
+					Next(nfIdx, SideCoord(M, nSide, M - nt, 1))
+				) / 4.0;
+				Next(fIdx, SideCoord(M, side, nt, 0)) = VertexPoint(Q, R, Prev(fIdx, SideCoord(N, side, t, 0)), 4.0);
+			}
+		}
+
+		// Base vertices can have any valence, every incident grid adds its corner cell and its outgoing side
+		#pragma omp parallel for if(parallel)
+		for (int vIdx = 0; vIdx < topology.vertexCount; ++vIdx)
+		{
+			int const begin = topology.vertexOffsets[vIdx];
+			int const end = topology.vertexOffsets[vIdx + 1];
+			double const D = static_cast<double>(end - begin);
+
+			Vector3 Q = Vector3::zero();
+			Vector3 R = Vector3::zero();
+			for (int itr = begin; itr < end; ++itr)
+			{
+				auto const [fIdx, corner] = topology.vertexCorners[itr];
+				Q += Next(fIdx, SideCoord(M, corner, 1, 1)) / D;
+				R += Next(fIdx, SideCoord(M, corner, 1, 0)) / D;
+			}
+			positions[vIdx] = VertexPoint(Q, R, prevPositions[vIdx], D);
+		}
+
+		return result;
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	int QuadGridMesh::GetResolution() const
+	{
+		return _resolution;
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	int QuadGridMesh::GetVertexCount() const
+	{
+		return static_cast<int>(_positions.size());
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	int QuadGridMesh::GetTriangleCount() const
+	{
+		return _topology->faceCount * _resolution * _resolution * 2;
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	int QuadGridMesh::GetPointIndex(int const faceIdx, int const i, int const j) const
+	{
+		MFA_ASSERT(faceIdx >= 0 && faceIdx < _topology->faceCount);
+		MFA_ASSERT(i >= 0 && i <= _resolution && j >= 0 && j <= _resolution);
+		return PointIndex(*_topology, _resolution, faceIdx, { i, j });
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	void QuadGridMesh::GetVertexNeighbors(int const vertexIdx, std::vector<int> & outVIds) const
+	{
+		auto const & topology = *_topology;
+		int const N = _resolution;
+
+		outVIds.clear();
+
+		int const edgePointsBegin = topology.vertexCount;
+		int const facePointsBegin = edgePointsBegin + topology.edgeCount * (N - 1);
+
+		if (vertexIdx < edgePointsBegin)
+		{
+			for (int itr = topology.vertexOffsets[vertexIdx]; itr < topology.vertexOffsets[vertexIdx + 1]; ++itr)
+			{
+				auto const [fIdx, corner] = topology.vertexCorners[itr];
+				outVIds.emplace_back(PointIndex(topology, N, fIdx, SideCoord(N, corner, 1, 0)));
+			}
+		}
+		else if (vertexIdx < facePointsBegin)
+		{
+			int const eIdx = (vertexIdx - edgePointsBegin) / (N - 1);
+			int const t = (vertexIdx - edgePointsBegin) % (N - 1) + 1;
+
+			int const fIdx = topology.edgeFaces[eIdx];
+			int const side = topology.edgeSides[eIdx];
+			int const nfIdx = topology.neighborFaces[fIdx][side];
+			int const nSide = topology.neighborSides[fIdx][side];
+
+			outVIds.emplace_back(PointIndex(topology, N, fIdx, SideCoord(N, side, t - 1, 0)));
+			outVIds.emplace_back(PointIndex(topology, N, fIdx, SideCoord(N, side, t + 1, 0)));
+			outVIds.emplace_back(PointIndex(topology, N, fIdx, SideCoord(N, side, t, 1)));
+			outVIds.emplace_back(PointIndex(topology, N, nfIdx, SideCoord(N, nSide, N - t, 1)));
+		}
+		else
+		{
+			int const cellsPerFace = (N - 1) * (N - 1);
+			int const fIdx = (vertexIdx - facePointsBegin) / cellsPerFace;
+			int const local = (vertexIdx - facePointsBegin) % cellsPerFace;
+			int const i = local % (N - 1) + 1;
+			int const j = local / (N - 1) + 1;
+
+			outVIds.emplace_back(PointIndex(topology, N, fIdx, { i - 1, j }));
+			outVIds.emplace_back(PointIndex(topology, N, fIdx, { i + 1, j }));
+			outVIds.emplace_back(PointIndex(topology, N, fIdx, { i, j - 1 }));
+			outVIds.emplace_back(PointIndex(topology, N, fIdx, { i, j + 1 }));
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	std::tuple<int, int, int> QuadGridMesh::GetTriangle(int const triangleIdx) const
+	{
+		int const N = _resolution;
+		int const trianglesPerFace = N * N * 2;
+
+		int const fIdx = triangleIdx / trianglesPerFace;
+		int const local = triangleIdx % trianglesPerFace;
+		int const cell = local / 2;
+		int const i = cell % N;
+		int const j = cell / N;
+
+		int const c0 = PointIndex(*_topology, N, fIdx, { i, j });
+		int const c2 = PointIndex(*_topology, N, fIdx, { i + 1, j + 1 });
+		if (local % 2 == 0)
+		{
+			return { c0, PointIndex(*_topology, N, fIdx, { i + 1, j }), c2 };
+		}
+		return { c2, PointIndex(*_topology, N, fIdx, { i, j + 1 }), c0 };
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	void QuadGridMesh::Triangulate(std::vector<uint32_t> & outIndices) const
+	{
+		int const triangleCount = GetTriangleCount();
+		outIndices.resize(static_cast<size_t>(triangleCount) * 3);
+
+		#pragma omp parallel for
+		for (int triIdx = 0; triIdx < triangleCount; ++triIdx)
+		{
+			auto const [idx0, idx1, idx2] = GetTriangle(triIdx);
+			outIndices[triIdx * 3] = idx0;
+			outIndices[triIdx * 3 + 1] = idx1;
+			outIndices[triIdx * 3 + 2] = idx2;
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	std::vector<QuadGridMesh::Vector3> & QuadGridMesh::GetPositions()
+	{
+		return _positions;
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	std::vector<QuadGridMesh::Vector3> const & QuadGridMesh::GetPositions() const
+	{
+		return _positions;
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	size_t QuadGridMesh::GetMemoryUsage() const
+	{
+		return _positions.capacity() * sizeof(Vector3) + _topology->GetMemoryUsage();
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	size_t QuadGridMesh::Topology::GetMemoryUsage() const
+	{
+		return
+			faceCorners.capacity() * sizeof(faceCorners[0]) +
+			faceEdges.capacity() * sizeof(faceEdges[0]) +
+			faceEdgeForward.capacity() * sizeof(faceEdgeForward[0]) +
+			neighborFaces.capacity() * sizeof(neighborFaces[0]) +
+			neighborSides.capacity() * sizeof(neighborSides[0]) +
+			edgeFaces.capacity() * sizeof(int) +
+			edgeSides.capacity() * sizeof(int) +
+			vertexOffsets.capacity() * sizeof(int) +
+			vertexCorners.capacity() * sizeof(vertexCorners[0]);
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	int QuadGridMesh::CalcVertexCount(Topology const & topology, int const resolution)
+	{
+		return topology.vertexCount +
+			topology.edgeCount * (resolution - 1) +
+			topology.faceCount * (resolution - 1) * (resolution - 1);
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	QuadGridMesh::GridCoord QuadGridMesh::SideCoord(int const resolution, int const side, int const t, int const depth)
+	{
+		switch (side)
+		{
+		case 0:
+			return { t, depth };
+		case 1:
+			return { resolution - depth, t };
+		case 2:
+			return { resolution - t, resolution - depth };
+		default:
+			return { depth, resolution - t };
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	int QuadGridMesh::PointIndex(Topology const & topology, int const resolution, int const faceIdx, GridCoord const & coord)
+	{
+		int const N = resolution;
+		auto const [i, j] = coord;
+
+		bool const onVerticalBorder = i == 0 || i == N;
+		bool const onHorizontalBorder = j == 0 || j == N;
+
+		if (onVerticalBorder == true && onHorizontalBorder == true)
+		{
+			int const corner = j == 0 ? (i == 0 ? 0 : 1) : (i == N ? 2 : 3);
+			return topology.faceCorners[faceIdx][corner];
+		}
+
+		if (onVerticalBorder == true || onHorizontalBorder == true)
+		{
+			int side;
+			int t;
+			if (j == 0)
+			{
+				side = 0;
+				t = i;
+			}
+			else if (i == N)
+			{
+				side = 1;
+				t = j;
+			}
+			else if (j == N)
+			{
+				side = 2;
+				t = N - i;
+			}
+			else
+			{
+				side = 3;
+				t = N - j;
+			}
+
+			int const eIdx = topology.faceEdges[faceIdx][side];
+			int const edgeT = topology.faceEdgeForward[faceIdx][side] == 1 ? t : N - t;
+			return topology.vertexCount + eIdx * (N - 1) + edgeT - 1;
+		}
+
+		return topology.vertexCount +
+			topology.edgeCount * (N - 1) +
+			faceIdx * (N - 1) * (N - 1) +
+			(j - 1) * (N - 1) + (i - 1);
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+}
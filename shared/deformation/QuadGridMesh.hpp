@@ -0,0 +1,114 @@
+#pragma once
+
+#include "geometrycentral/surface/manifold_surface_mesh.h"
+#include "geometrycentral/surface/vertex_position_geometry.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace shared
+{
+    // Catmull-Clark levels above the first one stored as one regular grid per base quad.
+    // The base is any mesh whose faces are all quads (e.g. the result of one subdivision step). A grid of resolution N
+    // has (N + 1)² points, the points on its border are shared with the neighbouring grids and are stored only once:
+    // base vertices first, then N - 1 points per base edge (from the edge's first vertex), then (N - 1)² per base face.
+    // Neighbour lookup, refinement and triangulation are index arithmetic over small per-base-element tables,
+    // so a level costs a position per vertex instead of a half-edge mesh and adjacency maps.
+    class QuadGridMesh
+    {
+    public:
+
+        using Mesh = geometrycentral::surface::ManifoldSurfaceMesh;
+        using Geometry = geometrycentral::surface::VertexPositionGeometry;
+        using Vector3 = geometrycentral::Vector3;
+        using GridCoord = std::array<int, 2>;
+
+        // Base mesh must be closed and contain quads only. Positions are taken from the geometry as level 0 of the grid.
+        explicit QuadGridMesh(Mesh & baseMesh, Geometry const & baseGeometry);
+
+        // Applies one Catmull-Clark step, the result shares the base tables with this grid.
+        // Uses the same rules as CatmullClarkSubdivide, only the vertex numbering is different (SubdivisionBenchmark
+        // compares both).
+        [[nodiscard]]
+        std::unique_ptr<QuadGridMesh> Subdivide(bool parallel) const;
+
+        // Number of cells along one side of every grid
+        [[nodiscard]]
+        int GetResolution() const;
+
+        [[nodiscard]]
+        int GetVertexCount() const;
+
+        [[nodiscard]]
+        int GetTriangleCount() const;
+
+        [[nodiscard]]
+        int GetPointIndex(int faceIdx, int i, int j) const;
+
+        // Vertices that share an edge of the quad mesh with the given vertex
+        void GetVertexNeighbors(int vertexIdx, std::vector<int> & outVIds) const;
+
+        // Each cell is split into (c0, c1, c2) and (c2, c3, c0) like SurfaceMesh does for quads
+        [[nodiscard]]
+        std::tuple<int, int, int> GetTriangle(int triangleIdx) const;
+
+        void Triangulate(std::vector<uint32_t> & outIndices) const;
+
+        [[nodiscard]]
+        std::vector<Vector3> & GetPositions();
+
+        [[nodiscard]]
+        std::vector<Vector3> const & GetPositions() const;
+
+        // Bytes used by the positions plus this level's share of the base tables
+        [[nodiscard]]
+        size_t GetMemoryUsage() const;
+
+    private:
+
+        struct Topology
+        {
+            int vertexCount = 0;
+            int edgeCount = 0;
+            int faceCount = 0;
+
+            // Corner c of a face is the tail of its c-th halfedge, side c goes from corner c to corner c + 1
+            std::vector<std::array<int, 4>> faceCorners{};
+            std::vector<std::array<int, 4>> faceEdges{};
+            std::vector<std::array<uint8_t, 4>> faceEdgeForward{};   // Side runs along the edge's own direction
+            std::vector<std::array<int, 4>> neighborFaces{};
+            std::vector<std::array<int, 4>> neighborSides{};
+
+            // Face and side that run along the edge's own direction
+            std::vector<int> edgeFaces{};
+            std::vector<int> edgeSides{};
+
+            // Faces around every vertex as (face, corner), vertex v owns [vertexOffsets[v], vertexOffsets[v + 1])
+            std::vector<int> vertexOffsets{};
+            std::vector<std::array<int, 2>> vertexCorners{};
+
+            [[nodiscard]]
+            size_t GetMemoryUsage() const;
+        };
+
+        explicit QuadGridMesh(std::shared_ptr<Topology const> topology, int resolution);
+
+        [[nodiscard]]
+        static int CalcVertexCount(Topology const & topology, int resolution);
+
+        // Point at parameter t along side k (measured from corner k), depth steps towards the inside of the grid
+        [[nodiscard]]
+        static GridCoord SideCoord(int resolution, int side, int t, int depth);
+
+        [[nodiscard]]
+        static int PointIndex(Topology const & topology, int resolution, int faceIdx, GridCoord const & coord);
+
+        std::shared_ptr<Topology const> _topology{};
+        int _resolution = 1;
+        std::vector<Vector3> _positions{};
+
+    };
+}
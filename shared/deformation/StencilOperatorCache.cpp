@@ -0,0 +1,108 @@
+#include "StencilOperatorCache.hpp"
+
+#include "BedrockAssert.hpp"
+
+namespace shared
+{
+
+	//-----------------------------------------------------------------------------------------
+
+	StencilOperatorCache::SparseMatrix const & StencilOperatorCache::GetOperator(
+		ContributionMapList const & contributionMaps,
+		int const fineLvl,
+		int const levelCount
+	)
+	{
+		MFA_ASSERT(levelCount > 0);
+		MFA_ASSERT(fineLvl - levelCount >= 0);
+		MFA_ASSERT(fineLvl <= static_cast<int>(contributionMaps.size()));
+
+		Validate(contributionMaps, fineLvl, levelCount);
+
+		auto const key = std::tuple{ fineLvl, levelCount };
+		auto const findResult = _operators.find(key);
+		if (findResult != _operators.end())
+		{
+			return findResult->second;
+		}
+
+		SparseMatrix result{};
+		if (levelCount == 1)
+		{
+			result = BuildStencilMatrix(*contributionMaps[fineLvl - 1]);
+		}
+		else
+		{
+			// The coarser part is cached as well so other (fineLvl, levelCount) pairs can reuse it
+			auto const & fineStep = GetOperator(contributionMaps, fineLvl, 1);
+			auto const & coarseSteps = GetOperator(contributionMaps, fineLvl - 1, levelCount - 1);
+			result = fineStep * coarseSteps;
+		}
+		result.makeCompressed();
+
+		return _operators.emplace(key, std::move(result)).first->second;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void StencilOperatorCache::Clear()
+	{
+		_operators.clear();
+		_sourceMaps.clear();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	StencilOperatorCache::SparseMatrix StencilOperatorCache::BuildStencilMatrix(ContributionMap const & contributionMap)
+	{
+		std::vector<Eigen::Triplet<float>> triplets{};
+		triplets.reserve(contributionMap.GetContributionCount());
+		contributionMap.ForEachContribution([&](Contribution const & contrib)->void
+		{
+			triplets.emplace_back(contrib.nextLvlVIdx, contrib.prevLvlVIdx, contrib.amount);
+		});
+
+		SparseMatrix result(contributionMap.GetNextLvlVertexCount(), contributionMap.GetPrevLvlVertexCount());
+		// Duplicate entries are summed
+		result.setFromTriplets(triplets.begin(), triplets.end());
+		return result;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void StencilOperatorCache::Validate(
+		ContributionMapList const & contributionMaps,
+		int const fineLvl,
+		int const levelCount
+	)
+	{
+		bool isValid = true;
+		for (int lvl = fineLvl - levelCount; lvl < fineLvl; ++lvl)
+		{
+			if (lvl < static_cast<int>(_sourceMaps.size()) && 
+				_sourceMaps[lvl] != nullptr && 
+				_sourceMaps[lvl] != contributionMaps[lvl].get())
+			{
+				isValid = false;
+				break;
+			}
+		}
+
+		if (isValid == false)
+		{
+			Clear();
+		}
+
+		if (static_cast<int>(_sourceMaps.size()) < fineLvl)
+		{
+			_sourceMaps.resize(fineLvl, nullptr);
+		}
+		for (int lvl = fineLvl - levelCount; lvl < fineLvl; ++lvl)
+		{
+			_sourceMaps[lvl] = contributionMaps[lvl].get();
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Contribution.hpp"
+
+#include <Eigen/Sparse>
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace shared
+{
+    // Lazily builds and keeps the composite subdivision operator between two levels.
+    // The operator of (fineLvl, levelCount) maps level (fineLvl - levelCount) vertices to level fineLvl vertices,
+    // rows are fine vertices and columns are coarse vertices. Entries of duplicate paths are merged.
+    class StencilOperatorCache
+    {
+    public:
+
+        using SparseMatrix = Eigen::SparseMatrix<float, Eigen::RowMajor>;
+        using ContributionMapList = std::vector<std::shared_ptr<ContributionMap>>;
+
+        // contributionMaps[i] must map level i to level i + 1.
+        // Cached operators are dropped automatically when one of the maps they are built from is replaced.
+        [[nodiscard]]
+        SparseMatrix const & GetOperator(
+            ContributionMapList const & contributionMaps,
+            int fineLvl,
+            int levelCount
+        );
+
+        void Clear();
+
+    private:
+
+        [[nodiscard]]
+        static SparseMatrix BuildStencilMatrix(ContributionMap const & contributionMap);
+
+        void Validate(ContributionMapList const & contributionMaps, int fineLvl, int levelCount);
+
+        std::map<std::tuple<int, int>, SparseMatrix> _operators{};      // (fineLvl, levelCount) -> operator
+        std::vector<ContributionMap const *> _sourceMaps{};             // Map that each level was built from
+
+    };
+}
@@ -0,0 +1,668 @@
+#include "Subdivision.hpp"
+
+#include "BedrockAssert.hpp"
+
+#include <array>
+#include <omp.h>
+
+namespace shared
+{
+
+	using namespace geometrycentral;
+	using namespace geometrycentral::surface;
+
+	//--------------------------------------------------------------------------------------------------------
+
+	namespace
+	{
+		// Contiguous storage for per-element stencils. Row i owns the slots [offsets[i], offsets[i + 1])
+		// and only the first counts[i] of them are filled.
+		struct StencilTable
+		{
+			std::vector<int> offsets{};
+			std::vector<int> counts{};
+			std::vector<int> indices{};
+			std::vector<float> weights{};
+
+			void Allocate(std::vector<int> const & capacities)
+			{
+				offsets.resize(capacities.size() + 1);
+				offsets[0] = 0;
+				for (int i = 0; i < static_cast<int>(capacities.size()); ++i)
+				{
+					offsets[i + 1] = offsets[i] + capacities[i];
+				}
+				counts.assign(capacities.size(), 0);
+				indices.resize(offsets.back());
+				weights.resize(offsets.back());
+			}
+
+			// Stencils are small (at most a few dozen entries) so a linear search is cheaper than hashing
+			void Add(int const row, int const vIdx, float const weight)
+			{
+				int const begin = offsets[row];
+				int & count = counts[row];
+				for (int i = begin; i < begin + count; ++i)
+				{
+					if (indices[i] == vIdx)
+					{
+						weights[i] += weight;
+						return;
+					}
+				}
+				MFA_ASSERT(begin + count < offsets[row + 1]);
+				indices[begin + count] = vIdx;
+				weights[begin + count] = weight;
+				++count;
+			}
+
+			// Scale is kept generic so that weights are multiplied in the same precision as before
+			template<typename Scale>
+			void AddScaled(int const row, StencilTable const & other, int const otherRow, Scale const scale)
+			{
+				int const begin = other.offsets[otherRow];
+				for (int i = begin; i < begin + other.counts[otherRow]; ++i)
+				{
+					Add(row, other.indices[i], other.weights[i] * scale);
+				}
+			}
+
+			void Emit(int const row, int const nextLvlVIdx, Contribution * outContribs) const
+			{
+				int const begin = offsets[row];
+				for (int i = 0; i < counts[row]; ++i)
+				{
+					outContribs[i] = Contribution{
+						.nextLvlVIdx = nextLvlVIdx,
+						.prevLvlVIdx = indices[begin + i],
+						.amount = weights[begin + i]
+					};
+				}
+			}
+		};
+
+		//----------------------------------------------------------------------------------------------------
+
+		// Weights of a vertex point whose adjacent faces are all quads, (Q + 2R + (D - 3)S) / D expanded
+		// over the one-ring. Every edge point is shared by two of the faces so R collapses into Q.
+		struct QuadVertexWeights
+		{
+			double self = 0.0;
+			double edgeNeighbor = 0.0;
+			double diagonal = 0.0;			// Opposite corner of each adjacent quad
+		};
+
+		constexpr int MinSpecializedValence = 3;
+		constexpr int MaxSpecializedValence = 8;
+
+		constexpr auto QuadVertexWeightTable = []()
+		{
+			std::array<QuadVertexWeights, MaxSpecializedValence + 1> table{};
+			for (int valence = MinSpecializedValence; valence <= MaxSpecializedValence; ++valence)
+			{
+				double const D = static_cast<double>(valence);
+				table[valence] = QuadVertexWeights{
+					.self = (D - 3.0) / D + 3.0 / (4.0 * D),
+					.edgeNeighbor = 3.0 / (2.0 * D * D),
+					.diagonal = 3.0 / (4.0 * D * D)
+				};
+			}
+			return table;
+		}();
+
+		static_assert(QuadVertexWeightTable[4].self == 7.0 / 16.0);
+		static_assert(QuadVertexWeightTable[4].edgeNeighbor == 3.0 / 32.0);
+		static_assert(QuadVertexWeightTable[4].diagonal == 3.0 / 64.0);
+
+		//----------------------------------------------------------------------------------------------------
+
+		// Returns false without touching the outputs if one of the adjacent faces is not a quad
+		template<int Valence>
+		bool EvaluateQuadVertex(
+			Vertex const v,
+			VertexPositionGeometry const & geo,
+			StencilTable & vToVContrib,
+			Vector3 & outPosition
+		)
+		{
+			constexpr QuadVertexWeights weights = QuadVertexWeightTable[Valence];
+
+			std::array<Vertex, Valence> edgeNeighbors{};
+			std::array<Vertex, Valence> diagonals{};
+
+			Halfedge he = v.halfedge();
+			for (int i = 0; i < Valence; ++i)
+			{
+				Halfedge const next = he.next();
+				Halfedge const opposite = next.next();
+				if (opposite.next().next() != he)
+				{
+					return false;
+				}
+				edgeNeighbors[i] = next.vertex();
+				diagonals[i] = opposite.vertex();
+				he = he.twin().next();
+			}
+			MFA_ASSERT(he == v.halfedge());
+
+			Vector3 edgeSum = Vector3::zero();
+			Vector3 diagonalSum = Vector3::zero();
+			for (int i = 0; i < Valence; ++i)
+			{
+				edgeSum += geo.inputVertexPositions[edgeNeighbors[i]];
+				diagonalSum += geo.inputVertexPositions[diagonals[i]];
+			}
+			outPosition =
+				geo.inputVertexPositions[v] * weights.self +
+				edgeSum * weights.edgeNeighbor +
+				diagonalSum * weights.diagonal;
+
+			int const row = static_cast<int>(v.getIndex());
+			vToVContrib.Add(row, row, static_cast<float>(weights.self));
+			for (int i = 0; i < Valence; ++i)
+			{
+				vToVContrib.Add(row, static_cast<int>(edgeNeighbors[i].getIndex()), static_cast<float>(weights.edgeNeighbor));
+			}
+			for (int i = 0; i < Valence; ++i)
+			{
+				vToVContrib.Add(row, static_cast<int>(diagonals[i].getIndex()), static_cast<float>(weights.diagonal));
+			}
+
+			return true;
+		}
+
+		//----------------------------------------------------------------------------------------------------
+
+		// Regular vertices are by far the most common ones after the first level so they are checked first
+		bool EvaluateSpecializedVertex(
+			Vertex const v,
+			VertexPositionGeometry const & geo,
+			StencilTable & vToVContrib,
+			Vector3 & outPosition
+		)
+		{
+			switch (v.degree())
+			{
+			case 4:
+				return EvaluateQuadVertex<4>(v, geo, vToVContrib, outPosition);
+			case 3:
+				return EvaluateQuadVertex<3>(v, geo, vToVContrib, outPosition);
+			case 5:
+				return EvaluateQuadVertex<5>(v, geo, vToVContrib, outPosition);
+			case 6:
+				return EvaluateQuadVertex<6>(v, geo, vToVContrib, outPosition);
+			case 7:
+				return EvaluateQuadVertex<7>(v, geo, vToVContrib, outPosition);
+			case 8:
+				return EvaluateQuadVertex<8>(v, geo, vToVContrib, outPosition);
+			default:
+				return false;
+			}
+		}
+
+		//----------------------------------------------------------------------------------------------------
+
+		// Edge point between two quads: both endpoints get 1/4 and the four remaining corners 1/8.
+		// These are exactly the float weights that merging the two face stencils produces.
+		bool EvaluateQuadEdge(Edge const e, StencilTable & vToEContrib)
+		{
+			Halfedge const he = e.halfedge();
+			Halfedge const twin = he.twin();
+			if (he.face().degree() != 4 || twin.face().degree() != 4)
+			{
+				return false;
+			}
+
+			int const row = static_cast<int>(e.getIndex());
+			vToEContrib.Add(row, static_cast<int>(he.vertex().getIndex()), 0.25f);
+			vToEContrib.Add(row, static_cast<int>(twin.vertex().getIndex()), 0.25f);
+			vToEContrib.Add(row, static_cast<int>(he.next().next().vertex().getIndex()), 0.125f);
+			vToEContrib.Add(row, static_cast<int>(he.next().next().next().vertex().getIndex()), 0.125f);
+			vToEContrib.Add(row, static_cast<int>(twin.next().next().vertex().getIndex()), 0.125f);
+			vToEContrib.Add(row, static_cast<int>(twin.next().next().next().vertex().getIndex()), 0.125f);
+			return true;
+		}
+
+		//----------------------------------------------------------------------------------------------------
+
+		// Result of the geometry pass. Everything is indexed by the element index of the coarse mesh.
+		struct RefinedPoints
+		{
+			std::vector<Vector3> facePoints{};
+			std::vector<Vector3> edgePoints{};
+			std::vector<Vector3> vertexPoints{};
+
+			StencilTable vToFContrib{};
+			StencilTable vToEContrib{};
+			StencilTable vToVContrib{};
+		};
+
+		//----------------------------------------------------------------------------------------------------
+
+		// Each element only reads the output of the previous phase, so the result does not depend on the
+		// number of threads nor on the order in which the elements are visited.
+		void ComputeRefinedPoints(
+			ManifoldSurfaceMesh & mesh,
+			VertexPositionGeometry const & geo,
+			bool const parallel,
+			bool const specializedStencils,
+			RefinedPoints & outPoints
+		)
+		{
+			MFA_ASSERT(mesh.isCompressed() == true);
+
+			int const nVertices = static_cast<int>(mesh.nVertices());
+			int const nEdges = static_cast<int>(mesh.nEdges());
+			int const nFaces = static_cast<int>(mesh.nFaces());
+
+			auto & vToFContrib = outPoints.vToFContrib;
+			auto & vToEContrib = outPoints.vToEContrib;
+			auto & vToVContrib = outPoints.vToVContrib;
+
+			{// Sizing the tables from the known element counts
+				std::vector<int> faceCapacities(nFaces);
+				#pragma omp parallel for if(parallel)
+				for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+				{
+					faceCapacities[fIdx] = static_cast<int>(mesh.face(fIdx).degree());
+				}
+				vToFContrib.Allocate(faceCapacities);
+
+				std::vector<int> edgeCapacities(nEdges);
+				#pragma omp parallel for if(parallel)
+				for (int eIdx = 0; eIdx < nEdges; ++eIdx)
+				{
+					Edge const e = mesh.edge(eIdx);
+					edgeCapacities[eIdx] =
+						faceCapacities[e.halfedge().face().getIndex()] +
+						faceCapacities[e.halfedge().twin().face().getIndex()];
+				}
+				vToEContrib.Allocate(edgeCapacities);
+
+				std::vector<int> vertexCapacities(nVertices);
+				#pragma omp parallel for if(parallel)
+				for (int vIdx = 0; vIdx < nVertices; ++vIdx)
+				{
+					int capacity = 1;
+					for (Edge e : mesh.vertex(vIdx).adjacentEdges())
+					{
+						capacity += edgeCapacities[e.getIndex()];
+					}
+					for (Face f : mesh.vertex(vIdx).adjacentFaces())
+					{
+						capacity += faceCapacities[f.getIndex()];
+					}
+					vertexCapacities[vIdx] = capacity;
+				}
+				vToVContrib.Allocate(vertexCapacities);
+			}
+
+			auto & splitFacePositions = outPoints.facePoints;
+			splitFacePositions.resize(nFaces);
+			#pragma omp parallel for if(parallel)
+			for (int fIdx = 0; fIdx < nFaces; ++fIdx) {
+				Face const f = mesh.face(fIdx);
+				double D = (double)f.degree();
+				splitFacePositions[fIdx] = Vector3::zero();
+				for (Vertex v : f.adjacentVertices()) {
+					splitFacePositions[fIdx] += geo.inputVertexPositions[v] / D;
+					vToFContrib.Add(fIdx, static_cast<int>(v.getIndex()), 1.0f / D);
+				}
+			}
+
+			auto & splitEdgePositions = outPoints.edgePoints;
+			splitEdgePositions.resize(nEdges);
+			#pragma omp parallel for if(parallel)
+			for (int eIdx = 0; eIdx < nEdges; ++eIdx) {
+				Edge const e = mesh.edge(eIdx);
+				std::array<int, 2> neigh{
+					static_cast<int>(e.halfedge().face().getIndex()),
+					static_cast<int>(e.halfedge().twin().face().getIndex())
+				};
+				splitEdgePositions[eIdx] = (splitFacePositions[neigh[0]] + splitFacePositions[neigh[1]]) / 2.;
+
+				if (specializedStencils == true && EvaluateQuadEdge(e, vToEContrib) == true)
+				{
+					continue;
+				}
+
+				vToEContrib.AddScaled(eIdx, vToFContrib, neigh[0], 0.5f);
+				vToEContrib.AddScaled(eIdx, vToFContrib, neigh[1], 0.5f);
+			}
+
+			auto & newPositions = outPoints.vertexPoints;
+			newPositions.resize(nVertices);
+			#pragma omp parallel for if(parallel)
+			for (int vIdx = 0; vIdx < nVertices; ++vIdx) {
+				Vertex const v = mesh.vertex(vIdx);
+
+				if (specializedStencils == true && EvaluateSpecializedVertex(v, geo, vToVContrib, newPositions[vIdx]) == true)
+				{
+					continue;
+				}
+
+				// Extraordinary vertex or a vertex next to a non-quad face
+				double D = (double)v.degree();
+
+				Vector3 S = geo.inputVertexPositions[v];
+
+				vToVContrib.Add(vIdx, vIdx, (double)(D - 3) / (double)D);
+
+				Vector3 R = Vector3::zero();
+
+				for (Edge e : v.adjacentEdges()) {
+					R += splitEdgePositions[e.getIndex()] / D;
+					vToVContrib.AddScaled(vIdx, vToEContrib, static_cast<int>(e.getIndex()), 2.0f / (D * D));
+				}
+
+				Vector3 Q = Vector3::zero();
+
+				for (Face f : v.adjacentFaces()) {
+					Q += splitFacePositions[f.getIndex()] / D;
+					vToVContrib.AddScaled(vIdx, vToFContrib, static_cast<int>(f.getIndex()), 1.0f / (D * D));
+				}
+
+				newPositions[vIdx] = (Q + 2 * R + (D - 3) * S) / D;
+			}
+		}
+
+		//----------------------------------------------------------------------------------------------------
+
+		// Original vertices keep their index, then one vertex per edge and one per face follow
+		std::vector<Contribution> EmitContributions(
+			RefinedPoints const & points,
+			std::vector<int> const & edgeVertexIndices,
+			std::vector<int> const & faceVertexIndices,
+			bool const parallel
+		)
+		{
+			int const nVertices = static_cast<int>(points.vertexPoints.size());
+			int const nEdges = static_cast<int>(points.edgePoints.size());
+			int const nFaces = static_cast<int>(points.facePoints.size());
+
+			// Output offset of every row, vertices first then edges and faces
+			std::vector<int> rowOffsets(nVertices + nEdges + nFaces + 1);
+			rowOffsets[0] = 0;
+			for (int i = 0; i < nVertices; ++i)
+			{
+				rowOffsets[i + 1] = rowOffsets[i] + points.vToVContrib.counts[i];
+			}
+			for (int i = 0; i < nEdges; ++i)
+			{
+				rowOffsets[nVertices + i + 1] = rowOffsets[nVertices + i] + points.vToEContrib.counts[i];
+			}
+			for (int i = 0; i < nFaces; ++i)
+			{
+				rowOffsets[nVertices + nEdges + i + 1] = rowOffsets[nVertices + nEdges + i] + points.vToFContrib.counts[i];
+			}
+
+			std::vector<Contribution> prevToNextContrib(rowOffsets.back());
+
+			#pragma omp parallel for if(parallel)
+			for (int vIdx = 0; vIdx < nVertices; ++vIdx)
+			{
+				points.vToVContrib.Emit(vIdx, vIdx, &prevToNextContrib[rowOffsets[vIdx]]);
+			}
+			#pragma omp parallel for if(parallel)
+			for (int eIdx = 0; eIdx < nEdges; ++eIdx)
+			{
+				points.vToEContrib.Emit(eIdx, edgeVertexIndices[eIdx], &prevToNextContrib[rowOffsets[nVertices + eIdx]]);
+			}
+			#pragma omp parallel for if(parallel)
+			for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+			{
+				points.vToFContrib.Emit(fIdx, faceVertexIndices[fIdx], &prevToNextContrib[rowOffsets[nVertices + nEdges + fIdx]]);
+			}
+
+			return prevToNextContrib;
+		}
+
+		//----------------------------------------------------------------------------------------------------
+
+		// Every face of degree D turns into D quads: (corner, next edge point, face point, previous edge point)
+		std::vector<std::vector<size_t>> RefineTopology(ManifoldSurfaceMesh & mesh, bool const parallel)
+		{
+			size_t const nVertices = mesh.nVertices();
+			size_t const nEdges = mesh.nEdges();
+			int const nFaces = static_cast<int>(mesh.nFaces());
+
+			std::vector<int> faceOffsets(nFaces + 1);
+			faceOffsets[0] = 0;
+			for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+			{
+				faceOffsets[fIdx + 1] = faceOffsets[fIdx] + static_cast<int>(mesh.face(fIdx).degree());
+			}
+
+			std::vector<std::vector<size_t>> polygons(faceOffsets.back());
+
+			#pragma omp parallel for if(parallel)
+			for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+			{
+				Face const f = mesh.face(fIdx);
+				size_t const faceVIdx = nVertices + nEdges + fIdx;
+
+				int corner = faceOffsets[fIdx];
+				for (Halfedge he : f.adjacentHalfedges())
+				{
+					// The halfedge that ends at this corner belongs to the previous edge of the face
+					Halfedge prevHe = he;
+					while (prevHe.next() != he)
+					{
+						prevHe = prevHe.next();
+					}
+
+					polygons[corner] = {
+						he.vertex().getIndex(),
+						nVertices + he.edge().getIndex(),
+						faceVIdx,
+						nVertices + prevHe.edge().getIndex()
+					};
+					++corner;
+				}
+			}
+
+			return polygons;
+		}
+
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	std::unique_ptr<ContributionMap> CatmullClarkSubdivide(
+		ManifoldSurfaceMesh& mesh,
+		VertexPositionGeometry& geo
+	)
+	{
+		// Element indices are used as rows of the stencil tables so they have to be dense
+		if (mesh.isCompressed() == false)
+		{
+			mesh.compress();
+		}
+
+		int const nVertices = static_cast<int>(mesh.nVertices());
+		int const nEdges = static_cast<int>(mesh.nEdges());
+		int const nFaces = static_cast<int>(mesh.nFaces());
+
+		RefinedPoints points{};
+		ComputeRefinedPoints(mesh, geo, false, false, points);
+
+		// Compute new positions for original vertices
+		VertexData<Vector3> newPositions(mesh);
+		for (int vIdx = 0; vIdx < nVertices; ++vIdx)
+		{
+			newPositions[vIdx] = points.vertexPoints[vIdx];
+		}
+
+		// Index of the vertex that each original edge and face turns into
+		std::vector<int> edgeVertexIndices(nEdges, -1);
+		std::vector<int> faceVertexIndices(nFaces, -1);
+
+		// Subdivide edges
+		VertexData<bool> isOrigVert(mesh, true);
+		EdgeData<bool> isOrigEdge(mesh, true);
+		for (Edge e : mesh.edges()) {
+			if (!isOrigEdge[e]) continue;
+
+			int const eIdx = static_cast<int>(e.getIndex());
+			Vector3 newPos = points.edgePoints[eIdx];
+
+			// split the edge
+			Halfedge newHe = mesh.insertVertexAlongEdge(e);
+			Vertex newV = newHe.vertex();
+
+			isOrigVert[newV] = false;
+			isOrigEdge[newHe.edge()] = false;
+			isOrigEdge[newHe.twin().next().edge()] = false;
+
+			GC_SAFETY_ASSERT(isOrigVert[newHe.twin().vertex()] && isOrigVert[newHe.twin().next().twin().vertex()], "???");
+
+			newPositions[newV] = newPos;
+			edgeVertexIndices[eIdx] = static_cast<int>(newV.getIndex());
+		}
+
+		// Subdivide faces
+		FaceData<bool> isOrigFace(mesh, true);
+		for (Face f : mesh.faces()) {
+			if (!isOrigFace[f]) continue;
+
+			int const fIdx = static_cast<int>(f.getIndex());
+			Vector3 newPos = points.facePoints[fIdx];
+
+			// split the face
+			Vertex newV = mesh.insertVertex(f);
+			isOrigVert[newV] = false;
+			newPositions[newV] = newPos;
+			faceVertexIndices[fIdx] = static_cast<int>(newV.getIndex());
+
+			for (Face f : newV.adjacentFaces()) {
+				isOrigFace[f] = false;
+			}
+
+			// get incoming halfedges before we start deleting edges
+			std::vector<Halfedge> incomingHalfedges;
+			for (Halfedge he : newV.incomingHalfedges()) {
+				incomingHalfedges.push_back(he);
+			}
+
+			for (Halfedge he : incomingHalfedges) {
+				if (isOrigVert[he.vertex()]) {
+					Face mergedF = mesh.removeEdge(he.edge());
+					if (mergedF == Face()) {
+						std::cout << "merge was impossible?" << std::endl;
+					}
+					else {
+						isOrigFace[mergedF] = false;
+					}
+				}
+			}
+		}
+
+		auto prevToNextContrib = EmitContributions(points, edgeVertexIndices, faceVertexIndices, false);
+
+		// No vertex is ever removed so compressing the mesh keeps the vertex indices that we recorded
+		mesh.compress();
+		MFA_ASSERT(static_cast<int>(mesh.nVertices()) == nVertices + nEdges + nFaces);
+
+		geo.inputVertexPositions = newPositions;
+		geo.refreshQuantities();
+
+		return std::make_unique<ContributionMap>(std::move(prevToNextContrib));
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	namespace
+	{
+		// Vertex order of the refined mesh: original vertices, then one vertex per edge, then one per face
+		void WriteRefinedPositions(RefinedPoints const & points, bool const parallel, VertexData<Vector3> & outPositions)
+		{
+			int const nVertices = static_cast<int>(points.vertexPoints.size());
+			int const nEdges = static_cast<int>(points.edgePoints.size());
+			int const nFaces = static_cast<int>(points.facePoints.size());
+
+			#pragma omp parallel for if(parallel)
+			for (int vIdx = 0; vIdx < nVertices; ++vIdx)
+			{
+				outPositions[vIdx] = points.vertexPoints[vIdx];
+			}
+			#pragma omp parallel for if(parallel)
+			for (int eIdx = 0; eIdx < nEdges; ++eIdx)
+			{
+				outPositions[nVertices + eIdx] = points.edgePoints[eIdx];
+			}
+			#pragma omp parallel for if(parallel)
+			for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+			{
+				outPositions[nVertices + nEdges + fIdx] = points.facePoints[fIdx];
+			}
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	void EvaluateSubdividedPositions(
+		ManifoldSurfaceMesh & mesh,
+		VertexPositionGeometry const & geo,
+		bool const parallel,
+		bool const specializedStencils,
+		VertexPositionGeometry & outGeometry
+	)
+	{
+		MFA_ASSERT(outGeometry.mesh.nVertices() == mesh.nVertices() + mesh.nEdges() + mesh.nFaces());
+
+		RefinedPoints points{};
+		ComputeRefinedPoints(mesh, geo, parallel, specializedStencils, points);
+		WriteRefinedPositions(points, parallel, outGeometry.inputVertexPositions);
+		outGeometry.refreshQuantities();
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+	SubdivisionResult CatmullClarkSubdivide(
+		ManifoldSurfaceMesh & mesh,
+		VertexPositionGeometry const & geo,
+		bool const parallel,
+		bool const specializedStencils
+	)
+	{
+		MFA_ASSERT(mesh.isCompressed() == true);
+
+		int const nVertices = static_cast<int>(mesh.nVertices());
+		int const nEdges = static_cast<int>(mesh.nEdges());
+		int const nFaces = static_cast<int>(mesh.nFaces());
+
+		// Topology pass
+		auto subdividedMesh = std::make_unique<ManifoldSurfaceMesh>(RefineTopology(mesh, parallel));
+		MFA_ASSERT(static_cast<int>(subdividedMesh->nVertices()) == nVertices + nEdges + nFaces);
+
+		// Geometry pass
+		RefinedPoints points{};
+		ComputeRefinedPoints(mesh, geo, parallel, specializedStencils, points);
+
+		auto subdividedGeometry = std::make_unique<VertexPositionGeometry>(*subdividedMesh);
+		WriteRefinedPositions(points, parallel, subdividedGeometry->inputVertexPositions);
+		subdividedGeometry->refreshQuantities();
+
+		std::vector<int> edgeVertexIndices(nEdges);
+		std::vector<int> faceVertexIndices(nFaces);
+		for (int eIdx = 0; eIdx < nEdges; ++eIdx)
+		{
+			edgeVertexIndices[eIdx] = nVertices + eIdx;
+		}
+		for (int fIdx = 0; fIdx < nFaces; ++fIdx)
+		{
+			faceVertexIndices[fIdx] = nVertices + nEdges + fIdx;
+		}
+
+		auto prevToNextContrib = EmitContributions(points, edgeVertexIndices, faceVertexIndices, parallel);
+
+		return SubdivisionResult{
+			.mesh = std::move(subdividedMesh),
+			.geometry = std::move(subdividedGeometry),
+			.contributionMap = std::make_unique<ContributionMap>(std::move(prevToNextContrib))
+		};
+	}
+
+	//--------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Contribution.hpp"
+#include "geometrycentral/surface/vertex_position_geometry.h"
+
+namespace shared
+{
+
+    // Subdivides the mesh in place by mutating its half-edge structure
+    std::unique_ptr<ContributionMap> CatmullClarkSubdivide(
+        geometrycentral::surface::ManifoldSurfaceMesh& mesh,
+        geometrycentral::surface::VertexPositionGeometry& geo
+    );
+
+    struct SubdivisionResult
+    {
+        std::unique_ptr<geometrycentral::surface::ManifoldSurfaceMesh> mesh{};
+        std::unique_ptr<geometrycentral::surface::VertexPositionGeometry> geometry{};
+        std::unique_ptr<ContributionMap> contributionMap{};
+    };
+
+    // Builds the refined connectivity directly from the input connectivity and then evaluates the new points
+    // and their stencils. The output only depends on the input, so it is bit-identical for any number of threads.
+    // Vertex order of the result: original vertices, then one vertex per edge, then one vertex per face.
+    // Input mesh must be compressed and is not modified.
+    // Specialized stencils evaluate vertices of valence 3 to 8 surrounded by quads (and edges between two quads) with
+    // precomputed weights, the generic path is kept for profiling. Both give the same mesh, positions and weights may
+    // differ in the last bits.
+    [[nodiscard]]
+    SubdivisionResult CatmullClarkSubdivide(
+        geometrycentral::surface::ManifoldSurfaceMesh & mesh,
+        geometrycentral::surface::VertexPositionGeometry const & geo,
+        bool parallel,
+        bool specializedStencils = true
+    );
+
+    // Geometry pass of CatmullClarkSubdivide on its own, for a level whose connectivity is already known (e.g. loaded
+    // from the SubdivisionCache). Writes the same positions as CatmullClarkSubdivide with the same stencil choice.
+    // outGeometry must belong to the subdivided mesh.
+    void EvaluateSubdividedPositions(
+        geometrycentral::surface::ManifoldSurfaceMesh & mesh,
+        geometrycentral::surface::VertexPositionGeometry const & geo,
+        bool parallel,
+        bool specializedStencils,
+        geometrycentral::surface::VertexPositionGeometry & outGeometry
+    );
+
+}
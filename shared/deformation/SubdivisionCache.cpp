@@ -0,0 +1,279 @@
+#include "SubdivisionCache.hpp"
+
+#include "BedrockAssert.hpp"
+#include "BedrockFile.hpp"
+#include "BedrockLog.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+using namespace geometrycentral::surface;
+
+namespace shared
+{
+
+	//-----------------------------------------------------------------------------------------
+
+	namespace
+	{
+		// Increase when the layout of the file or the subdivision scheme changes
+		constexpr uint32_t CacheVersion = 1;
+		constexpr uint32_t CacheMagic = 0x43434643;		// "CFCC"
+
+		constexpr uint64_t FnvOffsetBasis = 14695981039346656037ull;
+		constexpr uint64_t FnvPrime = 1099511628211ull;
+
+		struct Header
+		{
+			uint32_t magic = CacheMagic;
+			uint32_t version = CacheVersion;
+			uint64_t meshHash = 0;
+			int32_t level = 0;
+			int32_t prevLvlVertexCount = 0;
+			int32_t vertexCount = 0;
+			int32_t faceCount = 0;					// All faces are quads after one subdivision step
+			int64_t contributionCount = 0;
+			uint64_t payloadChecksum = 0;
+		};
+
+		static_assert(std::is_trivially_copyable_v<Header>);
+		static_assert(std::is_trivially_copyable_v<Contribution>);
+		static_assert(sizeof(Contribution) == 12);
+
+		using FaceIndices = int32_t[4];
+
+		uint64_t Fnv1a(uint64_t hash, void const * data, size_t const length)
+		{
+			auto const * bytes = static_cast<uint8_t const *>(data);
+			for (size_t i = 0; i < length; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= FnvPrime;
+			}
+			return hash;
+		}
+
+		size_t CalcFileSize(Header const & header)
+		{
+			return sizeof(Header) +
+				sizeof(FaceIndices) * static_cast<size_t>(header.faceCount) +
+				sizeof(Contribution) * static_cast<size_t>(header.contributionCount);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	SubdivisionCache::SubdivisionCache(std::string directory, Mesh & baseMesh)
+		: _directory(std::move(directory))
+		, _meshHash(HashConnectivity(baseMesh))
+	{}
+
+	//-----------------------------------------------------------------------------------------
+
+	bool SubdivisionCache::TryLoad(
+		int const level,
+		Mesh & prevLvlMesh,
+		Geometry const & prevLvlGeometry,
+		bool const parallel,
+		SubdivisionResult & outResult
+	) const
+	{
+		auto const path = GetLevelPath(level);
+
+		auto mappedFile = MFA::File::Map(path);
+		if (mappedFile == nullptr)
+		{
+			return false;
+		}
+
+		auto const Reject = [&](char const * reason)->bool
+		{
+			MFA_LOG_WARN("Subdivision cache %s is %s and will be rebuilt", path.c_str(), reason);
+			// The view must be closed before the file can be removed on windows
+			mappedFile.reset();
+			std::error_code errorCode{};
+			std::filesystem::remove(path, errorCode);
+			return false;
+		};
+
+		if (mappedFile->Len() < sizeof(Header))
+		{
+			return Reject("truncated");
+		}
+
+		Header header{};
+		std::memcpy(&header, mappedFile->Ptr(), sizeof(Header));
+
+		if (header.magic != CacheMagic || header.version != CacheVersion)
+		{
+			return Reject("from an unknown version");
+		}
+		if (header.meshHash != _meshHash || header.level != level)
+		{
+			return Reject("stale");
+		}
+		if (header.prevLvlVertexCount != static_cast<int>(prevLvlMesh.nVertices()) ||
+			header.faceCount <= 0 || header.contributionCount <= 0 ||
+			mappedFile->Len() != CalcFileSize(header))
+		{
+			return Reject("corrupt");
+		}
+
+		auto const * payload = mappedFile->Ptr() + sizeof(Header);
+		auto const payloadSize = mappedFile->Len() - sizeof(Header);
+		if (Fnv1a(FnvOffsetBasis, payload, payloadSize) != header.payloadChecksum)
+		{
+			return Reject("corrupt");
+		}
+
+		auto const * faces = reinterpret_cast<FaceIndices const *>(payload);
+		std::vector<std::vector<size_t>> polygons(header.faceCount);
+		#pragma omp parallel for
+		for (int fIdx = 0; fIdx < header.faceCount; ++fIdx)
+		{
+			auto const & face = faces[fIdx];
+			polygons[fIdx] = {
+				static_cast<size_t>(face[0]),
+				static_cast<size_t>(face[1]),
+				static_cast<size_t>(face[2]),
+				static_cast<size_t>(face[3])
+			};
+		}
+
+		std::vector<Contribution> contribs(header.contributionCount);
+		std::memcpy(
+			contribs.data(),
+			payload + sizeof(FaceIndices) * header.faceCount,
+			sizeof(Contribution) * header.contributionCount
+		);
+
+		// Everything that is needed has been copied out of the file
+		mappedFile.reset();
+
+		auto mesh = std::make_unique<Mesh>(polygons);
+		auto contributionMap = std::make_unique<ContributionMap>(std::move(contribs));
+		if (static_cast<int>(mesh->nVertices()) != header.vertexCount ||
+			contributionMap->GetNextLvlVertexCount() != header.vertexCount ||
+			contributionMap->GetPrevLvlVertexCount() != header.prevLvlVertexCount)
+		{
+			return Reject("corrupt");
+		}
+
+		// The stencils hold float weights, evaluating the positions with them would drift from an uncached session
+		auto geometry = std::make_unique<Geometry>(*mesh);
+		EvaluateSubdividedPositions(prevLvlMesh, prevLvlGeometry, parallel, true, *geometry);
+
+		outResult = SubdivisionResult{
+			.mesh = std::move(mesh),
+			.geometry = std::move(geometry),
+			.contributionMap = std::move(contributionMap)
+		};
+
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	void SubdivisionCache::Store(int const level, Mesh & mesh, ContributionMap const & contributionMap) const
+	{
+		auto const faceVertexList = mesh.getFaceVertexList();
+		std::vector<Contribution> contribs{};
+		contribs.reserve(contributionMap.GetContributionCount());
+		contributionMap.ForEachContribution([&](Contribution const & contrib)->void
+		{
+			contribs.emplace_back(contrib);
+		});
+
+		std::vector<int32_t> faces(faceVertexList.size() * 4);
+		for (size_t fIdx = 0; fIdx < faceVertexList.size(); ++fIdx)
+		{
+			auto const & faceVertices = faceVertexList[fIdx];
+			MFA_ASSERT(faceVertices.size() == 4);
+			for (size_t i = 0; i < 4; ++i)
+			{
+				faces[fIdx * 4 + i] = static_cast<int32_t>(faceVertices[i]);
+			}
+		}
+
+		Header header{
+			.meshHash = _meshHash,
+			.level = level,
+			.prevLvlVertexCount = contributionMap.GetPrevLvlVertexCount(),
+			.vertexCount = static_cast<int32_t>(mesh.nVertices()),
+			.faceCount = static_cast<int32_t>(faceVertexList.size()),
+			.contributionCount = static_cast<int64_t>(contribs.size()),
+		};
+		header.payloadChecksum = Fnv1a(FnvOffsetBasis, faces.data(), faces.size() * sizeof(int32_t));
+		header.payloadChecksum = Fnv1a(header.payloadChecksum, contribs.data(), contribs.size() * sizeof(Contribution));
+
+		std::error_code errorCode{};
+		std::filesystem::create_directories(_directory, errorCode);
+
+		// Writing to a temporary file first so a crash never leaves a half written file with a valid name
+		auto const path = GetLevelPath(level);
+		auto const tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (file.good() == false)
+			{
+				MFA_LOG_WARN("Failed to create subdivision cache file %s", tempPath.c_str());
+				return;
+			}
+			file.write(reinterpret_cast<char const *>(&header), sizeof(Header));
+			file.write(reinterpret_cast<char const *>(faces.data()), static_cast<std::streamsize>(faces.size() * sizeof(int32_t)));
+			file.write(reinterpret_cast<char const *>(contribs.data()), static_cast<std::streamsize>(contribs.size() * sizeof(Contribution)));
+			if (file.good() == false)
+			{
+				MFA_LOG_WARN("Failed to write subdivision cache file %s", tempPath.c_str());
+				file.close();
+				std::filesystem::remove(tempPath, errorCode);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tempPath, path, errorCode);
+		if (errorCode)
+		{
+			MFA_LOG_WARN("Failed to store subdivision cache file %s", path.c_str());
+			std::filesystem::remove(tempPath, errorCode);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	uint64_t SubdivisionCache::HashConnectivity(Mesh & mesh)
+	{
+		uint64_t hash = FnvOffsetBasis;
+
+		auto const vertexCount = static_cast<uint64_t>(mesh.nVertices());
+		hash = Fnv1a(hash, &vertexCount, sizeof(vertexCount));
+
+		for (auto const & faceVertices : mesh.getFaceVertexList())
+		{
+			auto const degree = static_cast<uint32_t>(faceVertices.size());
+			hash = Fnv1a(hash, &degree, sizeof(degree));
+			for (auto const vIdx : faceVertices)
+			{
+				auto const index = static_cast<uint32_t>(vIdx);
+				hash = Fnv1a(hash, &index, sizeof(index));
+			}
+		}
+
+		return hash;
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+	std::string SubdivisionCache::GetLevelPath(int const level) const
+	{
+		char fileName[64]{};
+		std::snprintf(fileName, sizeof(fileName), "%016llx_lvl%d.ccache", static_cast<unsigned long long>(_meshHash), level);
+		return std::filesystem::path(_directory).append(fileName).string();
+	}
+
+	//-----------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Subdivision.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace shared
+{
+    // Stores the refined connectivity and the prev -> next stencils of every subdivision level on disk.
+    // Files are keyed by a hash of the base mesh connectivity and are memory-mapped on load.
+    // Positions are never stored, they are re-evaluated from the previous level by the geometry pass of the subdivision,
+    // so a loaded level has the same positions as a freshly subdivided one.
+    class SubdivisionCache
+    {
+    public:
+
+        using Mesh = geometrycentral::surface::ManifoldSurfaceMesh;
+        using Geometry = geometrycentral::surface::VertexPositionGeometry;
+
+        explicit SubdivisionCache(std::string directory, Mesh & baseMesh);
+
+        // Returns false if the level is not cached or the file is stale or corrupt, in which case the file is removed.
+        // Positions match CatmullClarkSubdivide with its default (specialized) stencils.
+        [[nodiscard]]
+        bool TryLoad(
+            int level,
+            Mesh & prevLvlMesh,
+            Geometry const & prevLvlGeometry,
+            bool parallel,
+            SubdivisionResult & outResult
+        ) const;
+
+        void Store(int level, Mesh & mesh, ContributionMap const & contributionMap) const;
+
+        [[nodiscard]]
+        static uint64_t HashConnectivity(Mesh & mesh);
+
+    private:
+
+        [[nodiscard]]
+        std::string GetLevelPath(int level) const;
+
+        std::string _directory{};
+        uint64_t _meshHash = 0;
+
+    };
+}